@@ -1,28 +1,260 @@
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <chrono>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
 #include <opencv2/opencv.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/videoio.hpp>
+#include "pipeline.hpp"
 
-extern "C" {
-#include "vc.h"
+static void usage(const char* prog) {
+	std::cout << "Usage: " << prog << " [options] [video | directory ...]\n"
+		<< "  -i, --input <file>    Video file to process (default: videos/video1.mp4)\n"
+		<< "  --headless            Do not open a window nor draw the overlay\n"
+		<< "  -r, --report <file>   Write the final counts to <file>\n"
+		<< "  --serial              Run all stages on one thread\n"
+		<< "  --queue-depth <n>     Frames queued between pipeline stages (default: 4)\n"
+		<< "  --detect-threads <n>  Number of detection threads (default: 1)\n"
+		<< "  --kernel-threads <n>  Threads splitting each frame into bands of rows (default: 1, 0 = one per core)\n"
+		<< "  --affinity <list>     CPUs for decode,detect...,count,render (e.g. 0,1,2,3)\n"
+		<< "  --lut <bits>          Segment with a colour lookup table of 24, 21 or 18 bits\n"
+		<< "  --fixed-hsv           Convert to HSV with integers only (same result on every compiler)\n"
+		<< "  --lane <y>[:<x0>-<x1>] Counting line at row y (optionally only between columns x0 and x1);\n"
+		<< "                        repeat for several lanes (default: one line across the middle)\n"
+		<< "  --roi                 Only process a band around each counting line\n"
+		<< "  --max-coin <px>       Diameter of the largest coin, sets the band height and tracking gate (default: 200)\n"
+		<< "  --skip <n>            Detect every 1 to n frames, from the speed of the coins (default: 1)\n"
+		<< "  --close <k>           Size of the closing that fills the coin masks, odd (default: 3)\n"
+		<< "  --rle                 Segment, close and label the coin masks as runs of pixels\n"
+		<< "  --packed              Segment, close and label the coin masks packed 1 bit per pixel\n"
+		<< "  --strips <rows>       Median, colour mask and closing a strip of rows at a time (0 = sized for L2)\n"
+		<< "  --incremental <mad>   Only process the tiles that changed by more than mad per byte (0 = any change)\n"
+		<< "  --simd <set>          Colour kernels: none, sse4.1, avx2 or avx512 (default: best available)\n"
+		<< "  --check-simd          Check the SIMD colour kernels against the scalar code on the video and exit\n"
+		<< "  --cv-median           Median filter with cv::medianBlur instead of vc_median5\n"
+		<< "  --bench-median        Time cv::medianBlur against vc_median5 on the video and exit\n"
+		<< "  --full-edges          Edge overlay over the whole mask instead of around the coins\n"
+		<< "  --contours            Trace the contour of every coin: measured perimeter and outline\n"
+		<< "  --record <file>       Write the blobs of every frame to a trace file\n"
+		<< "  --replay <trace>      Count the coins of a trace for each configuration and exit (-j: threads)\n"
+		<< "  --configs <file>      Replay: one configuration per line, window=<rows> and\n"
+		<< "                        coin=<value>:<amin>:<amax>:<pmin>:<pmax> (default: the built-in rules)\n"
+		<< "  -j, --jobs <n>        Batch mode: videos processed at the same time (default: one per core)\n"
+		<< "  --out-dir <dir>       Batch mode: directory for the JSON results (default: results)\n"
+		<< "  -h, --help            Show this help\n"
+		<< "Batch mode is used when more than one video, a directory or --jobs is given.\n";
 }
 
-int main(void) {
-	char videofile[20] = "videos/video1.mp4";
+/// <summary>
+/// Parses the command line into opt. batch is set when several videos,
+/// a directory or --jobs are given.
+/// </summary>
+/// <returns>1 to continue, 0 to exit successfully (help), -1 on error</returns>
+static int parse_args(int argc, char** argv, Options& opt, bool& batch) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			usage(argv[0]);
+			return 0;
+		}
+		else if (arg == "--headless") {
+			opt.headless = true;
+		}
+		else if ((arg == "-i" || arg == "--input") && i + 1 < argc) {
+			opt.inputs.push_back(argv[++i]);
+		}
+		else if ((arg == "-r" || arg == "--report") && i + 1 < argc) {
+			opt.report = argv[++i];
+		}
+		else if (arg == "--serial") {
+			opt.serial = true;
+		}
+		else if (arg == "--queue-depth" && i + 1 < argc) {
+			opt.queueDepth = atoi(argv[++i]);
+		}
+		else if (arg == "--detect-threads" && i + 1 < argc) {
+			opt.detectThreads = atoi(argv[++i]);
+		}
+		else if (arg == "--kernel-threads" && i + 1 < argc) {
+			opt.kernelThreads = atoi(argv[++i]);
+		}
+		else if (arg == "--affinity" && i + 1 < argc) {
+			std::stringstream list(argv[++i]);
+			std::string cpu;
+			while (std::getline(list, cpu, ',')) opt.affinity.push_back(atoi(cpu.c_str()));
+		}
+		else if (arg == "--lut" && i + 1 < argc) {
+			opt.lutBits = atoi(argv[++i]);
+			if (opt.lutBits != 24 && opt.lutBits != 21 && opt.lutBits != 18) {
+				std::cerr << "--lut deve ser 24, 21 ou 18\n";
+				return -1;
+			}
+		}
+		else if (arg == "--lane" && i + 1 < argc) {
+			Lane lane;
+			if (sscanf(argv[++i], "%d:%d-%d", &lane.y, &lane.x0, &lane.x1) < 1) {
+				std::cerr << "Linha de contagem invalida: " << argv[i] << "\n";
+				return -1;
+			}
+			opt.lanes.push_back(lane);
+		}
+		else if (arg == "--roi") {
+			opt.roi = true;
+		}
+		else if (arg == "--close" && i + 1 < argc) {
+			opt.closeKernel = atoi(argv[++i]);
+			if (opt.closeKernel < 1 || opt.closeKernel > 127 || opt.closeKernel % 2 == 0) {
+				std::cerr << "--close deve ser impar, entre 1 e 127\n";
+				return -1;
+			}
+		}
+		else if (arg == "--fixed-hsv") {
+			opt.fixedHsv = true;
+		}
+		else if (arg == "--strips" && i + 1 < argc) {
+			opt.stripRows = atoi(argv[++i]);
+			if (opt.stripRows < 0) {
+				std::cerr << "--strips deve ser 0 ou positivo\n";
+				return -1;
+			}
+		}
+		else if (arg == "--incremental" && i + 1 < argc) {
+			opt.incremental = atoi(argv[++i]);
+			if (opt.incremental < 0) {
+				std::cerr << "--incremental deve ser 0 ou positivo\n";
+				return -1;
+			}
+		}
+		else if (arg == "--rle") {
+			opt.masks = MASK_RLE;
+		}
+		else if (arg == "--packed") {
+			opt.masks = MASK_BITS;
+		}
+		else if (arg == "--simd" && i + 1 < argc) {
+			std::string name = argv[++i];
+			opt.simd = -1;
+			for (int level = VC_SIMD_NONE; level <= VC_SIMD_AVX512; level++) {
+				if (name == vc_simd_name(level)) opt.simd = level;
+			}
+			if (opt.simd < 0) {
+				std::cerr << "--simd deve ser none, sse4.1, avx2 ou avx512\n";
+				return -1;
+			}
+			if (opt.simd > vc_simd_detect()) {
+				std::cerr << "O processador nao suporta " << name << "\n";
+				return -1;
+			}
+		}
+		else if (arg == "--check-simd") {
+			opt.checkSimd = true;
+		}
+		else if (arg == "--cv-median") {
+			opt.cvMedian = true;
+		}
+		else if (arg == "--bench-median") {
+			opt.benchMedian = true;
+		}
+		else if (arg == "--full-edges") {
+			opt.fullEdges = true;
+		}
+		else if (arg == "--contours") {
+			opt.contours = true;
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			opt.record = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			opt.replay = argv[++i];
+		}
+		else if (arg == "--configs" && i + 1 < argc) {
+			opt.configs = argv[++i];
+		}
+		else if (arg == "--max-coin" && i + 1 < argc) {
+			opt.maxCoin = atoi(argv[++i]);
+		}
+		else if (arg == "--skip" && i + 1 < argc) {
+			opt.maxSkip = atoi(argv[++i]);
+			if (opt.maxSkip < 1) {
+				std::cerr << "--skip deve ser 1 ou mais\n";
+				return -1;
+			}
+		}
+		else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+			opt.jobs = atoi(argv[++i]);
+			batch = true;
+		}
+		else if (arg == "--out-dir" && i + 1 < argc) {
+			opt.outDir = argv[++i];
+		}
+		else if (arg[0] != '-') {
+			opt.inputs.push_back(arg);
+		}
+		else {
+			std::cerr << "Opcao invalida: " << arg << "\n";
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if ((opt.stripRows >= 0) && (opt.masks != MASK_IMAGE)) {
+		std::cerr << "--strips nao pode ser usado com --rle nem com --packed\n";
+		return -1;
+	}
+	if ((opt.incremental >= 0) && ((opt.masks != MASK_IMAGE) || (opt.stripRows >= 0))) {
+		std::cerr << "--incremental nao pode ser usado com --rle, --packed nem --strips\n";
+		return -1;
+	}
+	if (opt.contours && (opt.masks == MASK_RLE)) {
+		std::cerr << "--contours nao pode ser usado com --rle\n";
+		return -1;
+	}
+	if (opt.inputs.empty()) opt.inputs.push_back("videos/video1.mp4");
+	if (opt.inputs.size() > 1 || std::filesystem::is_directory(opt.inputs[0])) batch = true;
+	if (!opt.record.empty() && batch && opt.replay.empty()) {
+		std::cerr << "--record nao pode ser usado no modo batch\n";
+		return -1;
+	}
+	return 1;
+}
+
+static void print_counts(std::ostream& out, const Counts& c, int nframes, double seconds) {
+	out << "Moedas de 200 : " << c.m200 << "\n"
+		<< "Moedas de 100 : " << c.m100 << "\n"
+		<< "Moedas de 50 : " << c.m50 << "\n"
+		<< "Moedas de 20 : " << c.m20 << "\n"
+		<< "Moedas de 10 : " << c.m10 << "\n"
+		<< "Moedas de 5 : " << c.m5 << "\n"
+		<< "Moedas de 2 : " << c.m2 << "\n"
+		<< "Moedas de 1 : " << c.m1 << "\n"
+		<< "Total : " << std::to_string(c.soma) << "\n"
+		<< "Total Moedas: " << c.cont2 << "\n"
+		<< "Frames : " << nframes << "\n"
+		<< "FPS : " << (seconds > 0 ? nframes / seconds : 0.0) << "\n";
+}
+
+int main(int argc, char** argv) {
+	Options opt;
+	bool batch = false;
+	int res = parse_args(argc, argv, opt, batch);
+	if (res <= 0) return res < 0 ? 1 : 0;
+
+	// Instruction set of the kernels, resolved here before any thread reads it
+	vc_simd_set_level(opt.simd >= 0 ? opt.simd : vc_simd_detect());
+	if (opt.checkSimd) return check_simd(opt);
+	vc_parallel_set_threads(opt.kernelThreads);
+	if (opt.benchMedian) return bench_median(opt);
+	if (!opt.replay.empty()) return run_replay(opt);
+
+	if (batch) return run_batch(opt);
+
 	cv::VideoCapture capture;
-	struct
-	{
-		int width, height;
-		int ntotalframes;
-		int fps;
-		int nframe;
-	} video;
-	std::string str;
-	int key = 0;
 
-	capture.open(videofile);
+	capture.open(opt.inputs[0]);
 
 	if (!capture.isOpened())
 	{
@@ -30,167 +262,21 @@ int main(void) {
 		return 1;
 	}
 
-	video.ntotalframes = (int)capture.get(cv::CAP_PROP_FRAME_COUNT);
-	video.fps = (int)capture.get(cv::CAP_PROP_FPS);
-	video.width = (int)capture.get(cv::CAP_PROP_FRAME_WIDTH);
-	video.height = (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT);
-
-	cv::namedWindow("VC - VIDEO1", cv::WINDOW_AUTOSIZE);
-	int h = round(video.height);
-	IVC* image = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageA = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageB = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageC = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageD = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageI = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageE = vc_image_new(video.width, video.height, 3, 255);
-	IVC* imageF = vc_image_new(video.width, video.height, 1, 255);
-	IVC* imageH = vc_image_new(video.width, video.height, 1, 255);
-
-	int cont = 0, cont2 = 0;
-	int m200 = 0, m100 = 0, m50 = 0, m20 = 0, m10 = 0, m5 = 0, m2 = 0, m1 = 0;
-	float soma = 0;
-
-	OVC* blobBuffer1 = NULL;
-	OVC* blobBuffer2 = NULL;
-	int nLablesBuffer = -1;
+	if (!opt.headless) cv::namedWindow("VC - VIDEO1", cv::WINDOW_AUTOSIZE);
 
-	cv::Mat frame;
-	cv::Mat frameA;
-	while (key != 'q') {
-		capture.read(frame);
-		if (frame.empty()) break;
-		video.nframe = (int)capture.get(cv::CAP_PROP_POS_FRAMES);
-		blobBuffer2 = (OVC*)calloc(10, sizeof(OVC));
-		cv::medianBlur(frame, frameA, 5);
-		memcpy(image->data, frameA.data, video.width * video.height * 3);
-		memcpy(imageI->data, frameA.data, video.width * video.height * 3);
-		int nlabels = 0;
-		vc_gbr_rgb(image);
-		vc_rgb_to_hsv(image, imageB);
-		vc_hsv_segmentation(imageB, imageC, 40, 60, 20, 80, 15, 55);
-		vc_hsv_segmentation(imageB, imageA, 19, 38, 37, 82, 13, 47);
-		vc_add_image(imageC, imageA);
-		vc_hsv_segmentation(imageB, imageC, 40, 200, 4, 24, 15, 50);
-		vc_add_image(imageC, imageA);
-		vc_binary_dilate(imageA, imageC, 3);
-		vc_binary_erode(imageC, imageA, 3);
-		vc_three_to_one_channel(imageA, imageF);
-		OVC* blobs = vc_binary_blob_labelling(imageF, imageH, &nlabels);
-		if (blobs != NULL) {
-			vc_binary_blob_info(imageH, blobs, nlabels);
-			blobs = vc_check_if_circle(blobs, &nlabels, imageF);
-			if (blobs != NULL) {
-				vc_draw_bounding_box(imageI, blobs, nlabels);
-				vc_gray_edge_prewitt(imageF, imageH);
-				vc_draw_edge(imageH, imageI);
-				vc_center(blobs, imageI, nlabels);
-				memcpy(frame.data, imageI->data, video.width * video.height * 3);
-				for (int i = 0; i < nlabels; i++) {
-					str = std::string("CENTRO DE MASSA : ").append(std::to_string(blobs[i].xc)).append(", y: ").append(std::to_string(blobs[i].yc));
-					cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 40), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
-					str = std::string("Area : ").append(std::to_string(blobs[i].area));
-					cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 20), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
-					str = std::string("Perimetro : ").append(std::to_string(blobs[i].perimeter));
-					cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 0), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
-
-					if ((image->height / 2 - 20) <= blobs[i].yc && (image->height / 2 + 20) >= blobs[i].yc) {
-						if (blobBuffer1 != NULL) {
-							int res = vc_main_collisions(blobs[i], blobBuffer1, nlabels);
-							if (res == 1) {
-								blobBuffer2[cont] = blobs[i];
-								cont++;
-								continue;
-							}
-						}
-						blobBuffer2[cont] = blobs[i];
-						cont++;
-						switch (idCoin(blobs[i].area, blobs[i].perimeter)) {
-						case 200:
-							m200++;
-							soma += 2;
-							cont2++;
-							break;
-						case 100:
-							m100++;
-							cont2++;
-							soma += 1;
-							break;
-						case 50:
-							m50++;
-							cont2++;
-							soma += 0.5;
-							break;
-						case 20:
-							m20++;
-							cont2++;
-							soma += 0.2;
-							break;
-						case 10:
-							m10++;
-							cont2++;
-							soma += 0.1;
-							break;
-						case 5:
-							m5++;
-							cont2++;
-							soma += 0.05;
-							break;
-						case 2:
-							m2++;
-							cont2++;
-							soma += 0.02;
-							break;
-						case 1:
-							m1++;
-							soma += 0.01;
-							cont2++;
-							break;
-						default:
-							break;
-						}
-					}
-				}
-			}
-		}
-		blobBuffer1 = blobBuffer2;
-		blobBuffer2 = NULL;
-		cont = 0;
-		str = std::string("Moedas de 200 : ").append(std::to_string(m200));
-		cv::putText(frame, str, cv::Point(20, 25), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 100 : ").append(std::to_string(m100));
-		cv::putText(frame, str, cv::Point(20, 50), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 50 : ").append(std::to_string(m50));
-		cv::putText(frame, str, cv::Point(20, 75), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 20 : ").append(std::to_string(m20));
-		cv::putText(frame, str, cv::Point(20, 100), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 10 : ").append(std::to_string(m10));
-		cv::putText(frame, str, cv::Point(20, 125), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 5 : ").append(std::to_string(m5));
-		cv::putText(frame, str, cv::Point(20, 150), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 2 : ").append(std::to_string(m2));
-		cv::putText(frame, str, cv::Point(20, 175), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Moedas de 1 : ").append(std::to_string(m1));
-		cv::putText(frame, str, cv::Point(20, 200), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Total : ").append(std::to_string(soma));
-		cv::putText(frame, str, cv::Point(20, 225), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
-		str = std::string("Total Moedas: ").append(std::to_string(cont2));
-		cv::putText(frame, str, cv::Point(20, 250), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
+	Counts counts;
+	auto start = std::chrono::steady_clock::now();
+	int nframes = run_video(opt, capture, counts);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-		cv::imshow("VC - VIDEO1", frame);
-		key = cv::waitKey(1);
+	print_counts(std::cout, counts, nframes, seconds);
+	if (!opt.report.empty()) {
+		std::ofstream report(opt.report);
+		if (!report) std::cerr << "Erro ao escrever o relatorio " << opt.report << "\n";
+		else print_counts(report, counts, nframes, seconds);
 	}
-	vc_image_free(image);
-	vc_image_free(imageA);
-	vc_image_free(imageB);
-	vc_image_free(imageC);
-	vc_image_free(imageD);
-	vc_image_free(imageE);
-	vc_image_free(imageF);
-	vc_image_free(imageH);
-	vc_image_free(imageI);
 
-	cv::destroyWindow("VC - VIDEO1");
+	if (!opt.headless) cv::destroyWindow("VC - VIDEO1");
 	capture.release();
 	return 0;
 }
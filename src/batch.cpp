@@ -0,0 +1,223 @@
+/*****************************************************************//**
+ * \file   batch.cpp
+ * \brief  Batch mode: processes many videos at the same time on a pool
+ *         of workers and writes one JSON result per video plus a summary.
+ *
+ * Every worker runs the serial headless path, so it owns its own frame
+ * slot, detector buffers and counters; nothing is shared between videos.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <set>
+#include <filesystem>
+#include "pipeline.hpp"
+
+namespace fs = std::filesystem;
+
+struct VideoResult {
+	std::string file;
+	std::string output;
+	bool ok = false;
+	Counts counts;
+	int nframes = 0;
+	double seconds = 0;
+};
+
+static bool is_video(const fs::path& path) {
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".mp4" || ext == ".avi" || ext == ".mov" || ext == ".mkv";
+}
+
+// Expands directories (not recursively) into the videos they contain
+static std::vector<std::string> list_videos(const std::vector<std::string>& inputs) {
+	std::vector<std::string> files;
+	for (const std::string& input : inputs) {
+		std::error_code ec;
+		if (fs::is_directory(input, ec)) {
+			std::vector<std::string> dir;
+			for (const auto& entry : fs::directory_iterator(input, ec)) {
+				if (entry.is_regular_file() && is_video(entry.path())) dir.push_back(entry.path().string());
+			}
+			std::sort(dir.begin(), dir.end());
+			files.insert(files.end(), dir.begin(), dir.end());
+		}
+		else files.push_back(input);
+	}
+	return files;
+}
+
+static std::string json_string(const std::string& str) {
+	std::string out = "\"";
+	for (char c : str) {
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			// Other control characters are not allowed raw in a JSON string
+			if ((unsigned char)c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+				out += escaped;
+			}
+			else out += c;
+		}
+	}
+	return out + "\"";
+}
+
+static void write_counts_json(std::ostream& out, const Counts& c, const char* indent) {
+	out << indent << "\"coins\": { \"200\": " << c.m200 << ", \"100\": " << c.m100 << ", \"50\": " << c.m50
+		<< ", \"20\": " << c.m20 << ", \"10\": " << c.m10 << ", \"5\": " << c.m5 << ", \"2\": " << c.m2
+		<< ", \"1\": " << c.m1 << " },\n"
+		<< indent << "\"total_coins\": " << c.cont2 << ",\n"
+		<< indent << "\"total_value\": " << std::to_string(c.soma) << ",\n";
+}
+
+static void write_result_json(std::ostream& out, const VideoResult& r, const char* indent) {
+	out << indent << "\"file\": " << json_string(r.file) << ",\n"
+		<< indent << "\"ok\": " << (r.ok ? "true" : "false") << ",\n";
+	write_counts_json(out, r.counts, indent);
+	out << indent << "\"frames\": " << r.nframes << ",\n"
+		<< indent << "\"seconds\": " << r.seconds << ",\n"
+		<< indent << "\"fps\": " << (r.seconds > 0 ? r.nframes / r.seconds : 0.0) << "\n";
+}
+
+static void add_counts(Counts& total, const Counts& c) {
+	total.m200 += c.m200;
+	total.m100 += c.m100;
+	total.m50 += c.m50;
+	total.m20 += c.m20;
+	total.m10 += c.m10;
+	total.m5 += c.m5;
+	total.m2 += c.m2;
+	total.m1 += c.m1;
+	total.cont2 += c.cont2;
+	total.soma += c.soma;
+}
+
+static void process_video(const Options& opt, VideoResult& result, VCPOOL* pool) {
+	cv::VideoCapture capture;
+	capture.open(result.file);
+	if (capture.isOpened()) {
+		auto start = std::chrono::steady_clock::now();
+		result.nframes = run_video(opt, capture, result.counts, pool);
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.ok = true;
+		capture.release();
+	}
+	else std::cerr << "Erro ao abrir o ficheiro de video " << result.file << "\n";
+
+	std::ofstream out(result.output);
+	if (!out) {
+		std::cerr << "Erro ao escrever " << result.output << "\n";
+		return;
+	}
+	out << "{\n";
+	write_result_json(out, result, "  ");
+	out << "}\n";
+}
+
+int run_batch(const Options& opt) {
+	std::vector<std::string> files = list_videos(opt.inputs);
+	if (files.empty()) {
+		std::cerr << "Nenhum video para processar\n";
+		return 1;
+	}
+
+	std::error_code ec;
+	fs::create_directories(opt.outDir, ec);
+
+	// One result file per video; name clashes get the index appended
+	std::vector<VideoResult> results(files.size());
+	std::set<std::string> names;
+	for (size_t i = 0; i < files.size(); i++) {
+		std::string name = fs::path(files[i]).stem().string();
+		if (!names.insert(name).second) name += "_" + std::to_string(i);
+		results[i].file = files[i];
+		results[i].output = (fs::path(opt.outDir) / (name + ".json")).string();
+	}
+
+	// Each worker processes whole videos on the serial headless path
+	Options worker = opt;
+	worker.headless = true;
+	worker.serial = true;
+	int jobs = opt.jobs > 0 ? opt.jobs : (int)std::thread::hardware_concurrency();
+	if (jobs < 1) jobs = 1;
+	if (jobs > (int)files.size()) jobs = (int)files.size();
+	// Parallelism comes from the pool; keep OpenCV from oversubscribing the cores
+	if (jobs > 1) cv::setNumThreads(1);
+
+	std::atomic<size_t> next(0);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int j = 0; j < jobs; j++) {
+		pool.emplace_back([&]() {
+			// Buffers are reused from one video to the next
+			VCPOOL* images = vc_pool_new();
+			for (size_t i = next++; i < results.size(); i = next++) {
+				process_video(worker, results[i], images);
+			}
+			vc_pool_free(images);
+		});
+	}
+	for (auto& t : pool) t.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Counts total;
+	int nframes = 0, failed = 0;
+	for (const VideoResult& r : results) {
+		if (!r.ok) {
+			failed++;
+			continue;
+		}
+		add_counts(total, r.counts);
+		nframes += r.nframes;
+	}
+
+	std::string summaryFile = (fs::path(opt.outDir) / "summary.json").string();
+	std::ofstream out(summaryFile);
+	if (!out) {
+		std::cerr << "Erro ao escrever " << summaryFile << "\n";
+		return 1;
+	}
+	out << "{\n"
+		<< "  \"videos\": " << results.size() << ",\n"
+		<< "  \"failed\": " << failed << ",\n"
+		<< "  \"jobs\": " << jobs << ",\n";
+	write_counts_json(out, total, "  ");
+	out << "  \"frames\": " << nframes << ",\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"fps\": " << (seconds > 0 ? nframes / seconds : 0.0) << ",\n"
+		<< "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		out << "    {\n";
+		write_result_json(out, results[i], "      ");
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+
+	std::cout << "Videos : " << results.size() << " (" << failed << " com erro)\n"
+		<< "Total Moedas: " << total.cont2 << "\n"
+		<< "Total : " << std::to_string(total.soma) << "\n"
+		<< "Frames : " << nframes << "\n"
+		<< "FPS : " << (seconds > 0 ? nframes / seconds : 0.0) << "\n"
+		<< "Resultados em " << opt.outDir << "\n";
+
+	return failed == 0 ? 0 : 1;
+}
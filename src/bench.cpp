@@ -0,0 +1,366 @@
+/*****************************************************************//**
+ * \file   bench.cpp
+ * \brief  vc_bench: times the vc_* kernels one at a time at 480p, 1080p
+ *         and 4K, on synthetic frames and on recorded frames, with every
+ *         thread count of the *_mt kernels.
+ *
+ * Reports the time per call, nanoseconds per pixel, the memory traffic of
+ * one pass over the source and destination images (GB/s) and the speedup
+ * over one thread, so a change to a kernel can be measured on its own.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "frames.hpp"
+
+namespace {
+
+struct Size {
+	const char* name;
+	int width, height;
+};
+
+const Size SIZES[] = {
+	{ "480p", 854, 480 },
+	{ "1080p", 1920, 1080 },
+	{ "4k", 3840, 2160 },
+};
+
+struct BenchOptions {
+	std::vector<std::string> sizes;
+	std::vector<int> threads;
+	std::vector<std::string> images;	// Recorded frames (PPM)
+	std::string filter;					// Only kernels whose name contains this
+	std::string csv;
+	double seconds = 0.2;				// Minimum time per measurement
+};
+
+// One kernel: a call on the buffers of the current frame
+struct Kernel {
+	std::string name;
+	double bytesPerPixel;		// Bytes read and written by one pass over src and dst
+	bool parallel;				// Runs on vc_parallel_threads() threads
+	std::function<int()> run;
+};
+
+// Buffers of one input frame, reused by every kernel
+struct Buffers {
+	IVC* bgr = NULL;
+	IVC* ref = NULL;
+	IVC* hsv = NULL;
+	IVC* color = NULL;
+	IVC* mask = NULL;
+	IVC* closed = NULL;
+	IVC* tmp = NULL;
+	IVC* labels8 = NULL;
+	LVC* labels = NULL;
+	BVC* bits = NULL;
+	BVC* bitsTmp = NULL;
+	RVC* rle = NULL;
+	HSVLUT* lut = NULL;
+	OVC* blobs = NULL;			// Blobs of labels8
+	int nblobs = 0;
+	OVC* blobsUf = NULL;		// Blobs of labels
+	int nblobsUf = 0;
+	int provisional = 0;		// Labels vc_binary_blob_labelling goes through
+	std::vector<unsigned char> dirty;
+
+	Buffers(IVC* frame) : bgr(frame) {
+		int w = frame->width, h = frame->height;
+		ref = vc_image_new(w, h, 3, 255);
+		hsv = vc_image_new(w, h, 3, 255);
+		color = vc_image_new(w, h, 3, 255);
+		mask = vc_image_new(w, h, 1, 255);
+		closed = vc_image_new(w, h, 1, 255);
+		tmp = vc_image_new(w, h, 1, 255);
+		labels8 = vc_image_new(w, h, 1, 255);
+		labels = vc_labels_new(w, h);
+		bits = vc_bits_new(w, h);
+		bitsTmp = vc_bits_new(w, h);
+		rle = vc_rle_new(w, h);
+		lut = vc_hsv_lut_new(21);
+		dirty.resize(((w + 63) / 64) * ((h + 63) / 64));
+		memcpy(ref->data, bgr->data, (size_t)bgr->bytesperline * h);
+
+		// Inputs of the later stages: mask, closed mask, labels
+		vc_hsv_lut_set(lut, COIN_COLORS, NCOIN_COLORS);
+		vc_bgr_to_mask(bgr, mask, COIN_COLORS, NCOIN_COLORS);
+		vc_binary_close(mask, closed, 3);
+		vc_bits_from_image(closed, bits);
+		blobsUf = vc_binary_blob_labelling_uf(closed, labels, &nblobsUf, NULL);
+		provisional = provisional_labels(closed);
+		if (provisional < 254) blobs = vc_binary_blob_labelling(closed, labels8, &nblobs);
+	}
+
+	~Buffers() {
+		free(blobs);
+		free(blobsUf);
+		vc_hsv_lut_free(lut);
+		vc_rle_free(rle);
+		vc_bits_free(bitsTmp);
+		vc_bits_free(bits);
+		vc_labels_free(labels);
+		vc_image_free(labels8);
+		vc_image_free(tmp);
+		vc_image_free(closed);
+		vc_image_free(mask);
+		vc_image_free(color);
+		vc_image_free(hsv);
+		vc_image_free(ref);
+	}
+
+	// vc_binary_blob_labelling keeps its labels in bytes: count the new labels it opens
+	static int provisional_labels(IVC* mask) {
+		int n = 0;
+		for (int y = 1; y < mask->height - 1; y++) {
+			const unsigned char* row = mask->data + (long)y * mask->bytesperline;
+			const unsigned char* up = row - mask->bytesperline;
+			for (int x = 1; x < mask->width - 1; x++) {
+				if (row[x] && !up[x - 1] && !up[x] && !up[x + 1] && !row[x - 1]) n++;
+			}
+		}
+		return n;
+	}
+};
+
+std::vector<Kernel> kernels_of(Buffers& b) {
+	std::vector<Kernel> k;
+	k.push_back({ "vc_rgb_to_hsv", 6, true, [&b]() { return vc_rgb_to_hsv_mt(b.bgr, b.hsv); } });
+	k.push_back({ "vc_rgb_to_hsv_fixed", 6, true, [&b]() { return vc_rgb_to_hsv_fixed_mt(b.bgr, b.hsv); } });
+	k.push_back({ "vc_hsv_segmentation", 6, true, [&b]() { return vc_hsv_segmentation_mt(b.hsv, b.color, 19, 38, 37, 82, 13, 47); } });
+	k.push_back({ "vc_bgr_to_mask", 4, true, [&b]() { return vc_bgr_to_mask_mt(b.bgr, b.mask, COIN_COLORS, NCOIN_COLORS); } });
+	k.push_back({ "vc_bgr_to_mask_fixed", 4, true, [&b]() { return vc_bgr_to_mask_fixed_mt(b.bgr, b.mask, COIN_COLORS, NCOIN_COLORS); } });
+	k.push_back({ "vc_bgr_to_mask_lut", 4, true, [&b]() { return vc_bgr_to_mask_lut_mt(b.bgr, b.mask, b.lut); } });
+	k.push_back({ "vc_bgr_to_bits", 3.125, true, [&b]() { return vc_bgr_to_bits_mt(b.bgr, b.bitsTmp, COIN_COLORS, NCOIN_COLORS); } });
+	k.push_back({ "vc_bgr_to_rle", 3, false, [&b]() { return vc_bgr_to_rle(b.bgr, b.rle, COIN_COLORS, NCOIN_COLORS); } });
+	k.push_back({ "vc_median5", 6, true, [&b]() { return vc_median5_mt(b.bgr, b.color); } });
+	k.push_back({ "vc_three_to_one_channel", 4, true, [&b]() { return vc_three_to_one_channel_mt(b.bgr, b.tmp); } });
+	k.push_back({ "vc_binary_dilate", 2, true, [&b]() { return vc_binary_dilate_mt(b.mask, b.tmp, 3); } });
+	k.push_back({ "vc_binary_erode", 2, true, [&b]() { return vc_binary_erode_mt(b.mask, b.tmp, 3); } });
+	k.push_back({ "vc_binary_dilate_vhgw", 2, false, [&b]() { return vc_binary_dilate_vhgw(b.mask, b.tmp, 3); } });
+	k.push_back({ "vc_binary_erode_vhgw", 2, false, [&b]() { return vc_binary_erode_vhgw(b.mask, b.tmp, 3); } });
+	k.push_back({ "vc_binary_close", 2, true, [&b]() { return vc_binary_close_mt(b.mask, b.tmp, 3); } });
+	k.push_back({ "vc_bits_dilate", 0.25, false, [&b]() { return vc_bits_dilate(b.bits, b.bitsTmp, 3); } });
+	k.push_back({ "vc_gray_edge_prewitt", 2, true, [&b]() { return vc_gray_edge_prewitt_mt(b.closed, b.tmp); } });
+	if (b.provisional < 254) {
+		k.push_back({ "vc_binary_blob_labelling", 2, false, [&b]() {
+			int n;
+			OVC* blobs = vc_binary_blob_labelling(b.closed, b.labels8, &n);
+			free(blobs);
+			return 1;
+		} });
+		k.push_back({ "vc_binary_blob_info", 1, false, [&b]() { return vc_binary_blob_info(b.labels8, b.blobs, b.nblobs); } });
+	}
+	k.push_back({ "vc_binary_blob_labelling_uf", 5, false, [&b]() {
+		int n;
+		OVC* blobs = vc_binary_blob_labelling_uf(b.closed, b.labels, &n, NULL);
+		free(blobs);
+		return 1;
+	} });
+	k.push_back({ "vc_bits_blob_labelling_uf", 4.125, false, [&b]() {
+		int n;
+		OVC* blobs = vc_bits_blob_labelling_uf(b.bits, b.labels, &n, NULL);
+		free(blobs);
+		return 1;
+	} });
+	k.push_back({ "vc_label_blob_info", 4, false, [&b]() { return vc_label_blob_info(b.labels, b.blobsUf, b.nblobsUf, NULL); } });
+	k.push_back({ "vc_dirty_tiles", 6, false, [&b]() { return vc_dirty_tiles(b.bgr, b.ref, 64, 4, b.dirty.data()) >= 0; } });
+	return k;
+}
+
+// Mean seconds per call: calls until seconds have passed (at least 3), after one warm-up call.
+// -1 if the kernel fails.
+double time_kernel(const Kernel& kernel, double seconds) {
+	if (!kernel.run()) return -1;
+	int calls = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	while ((calls < 3) || (elapsed < seconds)) {
+		kernel.run();
+		calls++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return elapsed / calls;
+}
+
+std::vector<std::string> split(const std::string& text) {
+	std::vector<std::string> parts;
+	std::stringstream in(text);
+	std::string part;
+	while (std::getline(in, part, ',')) {
+		if (!part.empty()) parts.push_back(part);
+	}
+	return parts;
+}
+
+void usage(const char* prog) {
+	std::cout << "Usage: " << prog << " [options]\n"
+		<< "  --sizes <list>        Frame sizes: 480p, 1080p, 4k (default: all)\n"
+		<< "  --threads <list>      Thread counts of the *_mt kernels, 1 is always measured (default: 1, 2, 4... up to one per core)\n"
+		<< "  --image <file.ppm>    Recorded frame, tiled to every size; repeat for several\n"
+		<< "  --kernel <text>       Only kernels whose name contains text\n"
+		<< "  --time <s>            Minimum time per measurement (default: 0.2)\n"
+		<< "  --csv <file>          Also write the results as CSV\n"
+		<< "  -h, --help            Show this help\n";
+}
+
+/// <summary>
+/// Parses the command line into opt.
+/// </summary>
+/// <returns>1 to continue, 0 to exit successfully (help), -1 on error</returns>
+int parse_args(int argc, char** argv, BenchOptions& opt) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			usage(argv[0]);
+			return 0;
+		}
+		else if (arg == "--sizes" && i + 1 < argc) {
+			opt.sizes = split(argv[++i]);
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			for (const std::string& n : split(argv[++i])) {
+				opt.threads.push_back(atoi(n.c_str()));
+				if (opt.threads.back() < 1) {
+					std::cerr << "--threads deve ter valores de 1 ou mais\n";
+					return -1;
+				}
+			}
+		}
+		else if (arg == "--image" && i + 1 < argc) {
+			opt.images.push_back(argv[++i]);
+		}
+		else if (arg == "--kernel" && i + 1 < argc) {
+			opt.filter = argv[++i];
+		}
+		else if (arg == "--time" && i + 1 < argc) {
+			opt.seconds = atof(argv[++i]);
+		}
+		else if (arg == "--csv" && i + 1 < argc) {
+			opt.csv = argv[++i];
+		}
+		else {
+			std::cerr << "Opcao invalida: " << arg << "\n";
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (opt.sizes.empty()) {
+		for (const Size& size : SIZES) opt.sizes.push_back(size.name);
+	}
+	if (opt.threads.empty()) {
+		int cores = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int n = 1; n < cores; n *= 2) opt.threads.push_back(n);
+		opt.threads.push_back(cores);
+	}
+	// The speedup is measured against one thread
+	if (std::find(opt.threads.begin(), opt.threads.end(), 1) == opt.threads.end()) opt.threads.insert(opt.threads.begin(), 1);
+	std::sort(opt.threads.begin(), opt.threads.end());
+	opt.threads.erase(std::unique(opt.threads.begin(), opt.threads.end()), opt.threads.end());
+	return 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+	BenchOptions opt;
+	int res = parse_args(argc, argv, opt);
+	if (res <= 0) return res < 0 ? 1 : 0;
+
+	std::vector<const Size*> sizes;
+	for (const std::string& name : opt.sizes) {
+		const Size* found = NULL;
+		for (const Size& size : SIZES) {
+			if (name == size.name) found = &size;
+		}
+		if (found == NULL) {
+			std::cerr << "Tamanho invalido: " << name << "\n";
+			return 1;
+		}
+		sizes.push_back(found);
+	}
+
+	std::vector<std::pair<std::string, IVC*>> recorded;
+	for (const std::string& file : opt.images) {
+		IVC* frame = read_frame(file.c_str());
+		if (frame == NULL) {
+			std::cerr << "Erro ao ler a imagem " << file << " (PPM a cores)\n";
+			return 1;
+		}
+		recorded.push_back({ file, frame });
+	}
+
+	std::ofstream csv;
+	if (!opt.csv.empty()) {
+		csv.open(opt.csv);
+		if (!csv) {
+			std::cerr << "Erro ao criar " << opt.csv << "\n";
+			return 1;
+		}
+		csv << "input,size,kernel,threads,ms,ns_per_pixel,gb_per_s,speedup\n";
+	}
+
+	printf("simd: %s, cores: %u\n", vc_simd_name(vc_simd_level()), std::thread::hardware_concurrency());
+	printf("%-12s %-6s %-28s %7s %10s %8s %8s %8s\n", "input", "size", "kernel", "threads", "ms", "ns/px", "GB/s", "speedup");
+
+	for (size_t input = 0; input <= recorded.size(); input++) {
+		std::string name = input == 0 ? "synthetic" : recorded[input - 1].first;
+		for (const Size* size : sizes) {
+			IVC* frame = input == 0 ? synthetic_frame(size->width, size->height) : tiled_frame(recorded[input - 1].second, size->width, size->height);
+			if (frame == NULL) {
+				std::cerr << "Sem memoria para " << size->name << "\n";
+				return 1;
+			}
+			double pixels = (double)size->width * size->height;
+			Buffers buffers(frame);
+			bool legacy = opt.filter.empty() || (std::string("vc_binary_blob_labelling vc_binary_blob_info").find(opt.filter) != std::string::npos);
+			if (legacy && (buffers.provisional >= 254)) {
+				std::cerr << "vc_binary_blob_labelling ignorado em " << name << " " << size->name << ": mais de 254 etiquetas\n";
+			}
+
+			for (const Kernel& kernel : kernels_of(buffers)) {
+				if (!opt.filter.empty() && (kernel.name.find(opt.filter) == std::string::npos)) continue;
+				double single = 0;
+				for (size_t t = 0; t < (kernel.parallel ? opt.threads.size() : 1); t++) {
+					int threads = kernel.parallel ? opt.threads[t] : 1;
+					vc_parallel_set_threads(threads);
+					double seconds = time_kernel(kernel, opt.seconds);
+					if (seconds < 0) {
+						std::cerr << kernel.name << " falhou em " << name << " " << size->name << "\n";
+						break;
+					}
+					if (t == 0) single = seconds;
+					double speedup = single / seconds;
+					double nsPerPixel = seconds * 1e9 / pixels;
+					double gbPerSecond = kernel.bytesPerPixel * pixels / seconds / 1e9;
+
+					printf("%-12s %-6s %-28s %7d %10.3f %8.3f %8.2f %8.2f\n", name.c_str(), size->name, kernel.name.c_str(), threads,
+						seconds * 1e3, nsPerPixel, gbPerSecond, speedup);
+					fflush(stdout);
+					if (csv.is_open()) {
+						csv << name << "," << size->name << "," << kernel.name << "," << threads << "," << seconds * 1e3 << ","
+							<< nsPerPixel << "," << gbPerSecond << "," << speedup << "\n";
+					}
+				}
+			}
+			vc_image_free(frame);
+		}
+	}
+	vc_parallel_set_threads(1);
+
+	for (auto& frame : recorded) vc_image_free(frame.second);
+	return 0;
+}
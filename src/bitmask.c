@@ -0,0 +1,299 @@
+/*****************************************************************//**
+ * \file   bitmask.c
+ * \brief  Binary images packed 1 bit per pixel in 64-bit words, with
+ *         morphology and logic operations done a word at a time.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Row buffer of dilate/erode kept on the stack (4096 pixels)
+#define VC_BITS_MAX_STACK_WORDS 64
+
+// Bits of the last word of a row that are inside the image
+static uint64_t bits_last_mask(int width) {
+	int n = width % 64;
+	return n == 0 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+}
+
+// dst[i] = a[i] | b[i]
+static void bits_or_words(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n) {
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 4 <= n; i += 4) {
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(va, vb));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 2 <= n; i += 2) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(va, vb));
+	}
+#endif
+	for (; i < n; i++) dst[i] = a[i] | b[i];
+}
+
+// dst[i] = a[i] & b[i]
+static void bits_and_words(uint64_t* dst, const uint64_t* a, const uint64_t* b, size_t n) {
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 4 <= n; i += 4) {
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(va, vb));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	for (; i + 2 <= n; i += 2) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(va, vb));
+	}
+#endif
+	for (; i < n; i++) dst[i] = a[i] & b[i];
+}
+
+/// <summary>
+/// Creates a packed binary image, all pixels 0.
+/// </summary>
+/// <returns>Pointer to the image, or NULL on error</returns>
+BVC* vc_bits_new(int width, int height) {
+	BVC* bits;
+
+	if ((width <= 0) || (height <= 0)) return NULL;
+
+	bits = (BVC*)malloc(sizeof(BVC));
+	if (bits == NULL) return NULL;
+
+	bits->width = width;
+	bits->height = height;
+	bits->words = (width + 63) / 64;
+	bits->data = (uint64_t*)calloc((size_t)bits->words * height, sizeof(uint64_t));
+	if (bits->data == NULL) {
+		free(bits);
+		return NULL;
+	}
+	return bits;
+}
+
+BVC* vc_bits_free(BVC* bits) {
+	if (bits != NULL) {
+		free(bits->data);
+		free(bits);
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Packs n bytes (0 = background) into (n + 63) / 64 words; the bits past n are 0.
+/// </summary>
+void vc_bits_pack_row(const unsigned char* src, int n, uint64_t* dst) {
+	int w, x, k;
+
+	for (w = 0; w * 64 < n; w++, src += 64) {
+		uint64_t word = 0;
+		k = n - w * 64 < 64 ? n - w * 64 : 64;
+		x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		// Full words: one bit per byte from the sign of (byte == 0), 16 bytes at a time
+		if (k == 64) {
+			const __m128i zero = _mm_setzero_si128();
+			for (; x < 64; x += 16) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+				word |= (uint64_t)(~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xffff) << x;
+			}
+		}
+#endif
+		for (; x < k; x++) word |= (uint64_t)(src[x] != 0) << x;
+		dst[w] = word;
+	}
+}
+
+/// <summary>
+/// Unpacks the first n pixels of a row of words: 255 for set bits, 0 elsewhere.
+/// </summary>
+void vc_bits_unpack_row(const uint64_t* src, int n, unsigned char* dst) {
+	int w, x, k;
+
+	for (w = 0; w * 64 < n; w++, dst += 64) {
+		uint64_t word = src[w];
+		k = n - w * 64 < 64 ? n - w * 64 : 64;
+		if (word == 0) {
+			memset(dst, 0, k);
+			continue;
+		}
+		for (x = 0; x < k; x++) dst[x] = (word >> x) & 1 ? 255 : 0;
+	}
+}
+
+/// <summary>
+/// Packs a binary image (1 channel, 0 = background).
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_from_image(IVC* src, BVC* dst) {
+	int y;
+
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1)) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		vc_bits_pack_row(src->data + y * src->bytesperline, src->width, dst->data + (size_t)y * dst->words);
+	}
+	return 1;
+}
+
+/// <summary>
+/// Unpacks to a binary image: 255 for set bits, 0 elsewhere.
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_to_image(BVC* src, IVC* dst) {
+	int y;
+
+	if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 1)) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		vc_bits_unpack_row(src->data + (size_t)y * src->words, src->width, dst->data + y * dst->bytesperline);
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same result as vc_binary_dilate. The rows of the kernel are ORed together
+/// (SIMD), then the row is ORed with itself shifted 1 to kernel / 2 pixels left
+/// and right: a few word operations per 64 pixels.
+/// </summary>
+/// <param name="src">Source image</param>
+/// <param name="dst">Destination image (not src)</param>
+/// <param name="kernel">Size of the square structuring element (odd, up to 127)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_dilate(BVC* src, BVC* dst, int kernel) {
+	uint64_t stack[VC_BITS_MAX_STACK_WORDS];
+	uint64_t* row;
+	int words = src->words;
+	uint64_t last = bits_last_mask(src->width);
+	int bound, y, k, w, s;
+
+	if ((src == dst) || (kernel < 1) || (kernel % 2 == 0) || (kernel > 127)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+
+	row = words <= VC_BITS_MAX_STACK_WORDS ? stack : (uint64_t*)malloc(words * sizeof(uint64_t));
+	if (row == NULL) return 0;
+
+	bound = (kernel - 1) / 2;
+	for (y = 0; y < src->height; y++) {
+		uint64_t* pd = dst->data + (size_t)y * words;
+		int y0 = y - bound < 0 ? 0 : y - bound;
+		int y1 = y + bound >= src->height ? src->height - 1 : y + bound;
+
+		// Vertical: OR of the rows of the kernel (rows outside the image are 0)
+		memcpy(row, src->data + (size_t)y0 * words, words * sizeof(uint64_t));
+		for (k = y0 + 1; k <= y1; k++) bits_or_words(row, row, src->data + (size_t)k * words, words);
+
+		// Horizontal: pixel x takes the pixels x - s and x + s
+		for (w = 0; w < words; w++) {
+			uint64_t prev = w > 0 ? row[w - 1] : 0;
+			uint64_t next = w < words - 1 ? row[w + 1] : 0;
+			uint64_t word = row[w];
+			for (s = 1; s <= bound; s++) {
+				word |= (row[w] << s) | (prev >> (64 - s));
+				word |= (row[w] >> s) | (next << (64 - s));
+			}
+			pd[w] = word;
+		}
+		pd[words - 1] &= last;
+	}
+
+	if (row != stack) free(row);
+	return 1;
+}
+
+/// <summary>
+/// Same result as vc_binary_erode (pixels outside the image are ignored): AND of
+/// the rows of the kernel (SIMD), then AND with the row shifted 1 to kernel / 2
+/// pixels left and right, with ones shifted in from outside the image.
+/// </summary>
+/// <param name="src">Source image</param>
+/// <param name="dst">Destination image (not src)</param>
+/// <param name="kernel">Size of the square structuring element (odd, up to 127)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_erode(BVC* src, BVC* dst, int kernel) {
+	uint64_t stack[VC_BITS_MAX_STACK_WORDS];
+	uint64_t* row;
+	int words = src->words;
+	uint64_t last = bits_last_mask(src->width);
+	int bound, y, k, w, s;
+
+	if ((src == dst) || (kernel < 1) || (kernel % 2 == 0) || (kernel > 127)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+
+	row = words <= VC_BITS_MAX_STACK_WORDS ? stack : (uint64_t*)malloc(words * sizeof(uint64_t));
+	if (row == NULL) return 0;
+
+	bound = (kernel - 1) / 2;
+	for (y = 0; y < src->height; y++) {
+		uint64_t* pd = dst->data + (size_t)y * words;
+		int y0 = y - bound < 0 ? 0 : y - bound;
+		int y1 = y + bound >= src->height ? src->height - 1 : y + bound;
+
+		// Vertical: AND of the rows of the kernel inside the image
+		memcpy(row, src->data + (size_t)y0 * words, words * sizeof(uint64_t));
+		for (k = y0 + 1; k <= y1; k++) bits_and_words(row, row, src->data + (size_t)k * words, words);
+		// Past the right border counts as set
+		row[words - 1] |= ~last;
+
+		// Horizontal: pixel x needs the pixels x - s and x + s
+		for (w = 0; w < words; w++) {
+			uint64_t prev = w > 0 ? row[w - 1] : ~(uint64_t)0;
+			uint64_t next = w < words - 1 ? row[w + 1] : ~(uint64_t)0;
+			uint64_t word = row[w];
+			for (s = 1; s <= bound; s++) {
+				word &= (row[w] << s) | (prev >> (64 - s));
+				word &= (row[w] >> s) | (next << (64 - s));
+			}
+			pd[w] = word;
+		}
+		pd[words - 1] &= last;
+	}
+
+	if (row != stack) free(row);
+	return 1;
+}
+
+/// <summary>
+/// dst = a OR b, pixel by pixel (dst may be a or b).
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_or(BVC* a, BVC* b, BVC* dst) {
+	if ((a->width != b->width) || (a->height != b->height)) return 0;
+	if ((a->width != dst->width) || (a->height != dst->height)) return 0;
+
+	bits_or_words(dst->data, a->data, b->data, (size_t)a->words * a->height);
+	return 1;
+}
+
+/// <summary>
+/// dst = a AND b, pixel by pixel (dst may be a or b).
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_bits_and(BVC* a, BVC* b, BVC* dst) {
+	if ((a->width != b->width) || (a->height != b->height)) return 0;
+	if ((a->width != dst->width) || (a->height != dst->height)) return 0;
+
+	bits_and_words(dst->data, a->data, b->data, (size_t)a->words * a->height);
+	return 1;
+}
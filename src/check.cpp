@@ -0,0 +1,149 @@
+/*****************************************************************//**
+ * \file   check.cpp
+ * \brief  vc_check: checks that every instruction set supported by the
+ *         processor gives exactly the same masks (vc_bgr_to_mask and
+ *         vc_bgr_to_bits) and HSV images (vc_rgb_to_hsv) as the scalar code, on synthetic frames,
+ *         random pixels and recorded frames. Run by ctest.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "frames.hpp"
+
+namespace {
+
+struct Input {
+	std::string name;
+	IVC* frame;
+};
+
+// Frame sizes: the video sizes, plus odd widths for the tails of the SIMD rows
+const int SIZES[][2] = {
+	{ 854, 480 },
+	{ 1920, 1080 },
+	{ 97, 31 },
+	{ 15, 4 },
+	{ 1, 1 },
+};
+
+void usage(const char* prog) {
+	std::cout << "Usage: " << prog << " [options]\n"
+		<< "  --image <file.ppm>    Recorded frame, also tiled to every size; repeat for several\n"
+		<< "  -h, --help            Show this help\n";
+}
+
+/// <summary>
+/// Compares the masks and HSV image of one frame at every level with the scalar code.
+/// </summary>
+/// <returns>Number of levels that differ</returns>
+int check_frame(const std::string& name, IVC* frame, int best) {
+	int width = frame->width, height = frame->height;
+	IVC* mask0 = vc_image_new(width, height, 1, 255);
+	IVC* mask1 = vc_image_new(width, height, 1, 255);
+	IVC* hsv0 = vc_image_new(width, height, 3, 255);
+	IVC* hsv1 = vc_image_new(width, height, 3, 255);
+	BVC* bits0 = vc_bits_new(width, height);
+	BVC* bits1 = vc_bits_new(width, height);
+	size_t bitsBytes = (size_t)bits0->words * height * sizeof(uint64_t);
+	int failed = 0;
+
+	// Reference: the scalar code
+	vc_simd_set_level(VC_SIMD_NONE);
+	vc_bgr_to_mask(frame, mask0, COIN_COLORS, NCOIN_COLORS);
+	vc_rgb_to_hsv(frame, hsv0);
+	vc_bgr_to_bits(frame, bits0, COIN_COLORS, NCOIN_COLORS);
+
+	for (int level = VC_SIMD_SSE41; level <= best; level++) {
+		vc_simd_set_level(level);
+		memset(mask1->data, 0xaa, (size_t)mask1->bytesperline * height);
+		memset(hsv1->data, 0xaa, (size_t)hsv1->bytesperline * height);
+		memset(bits1->data, 0xaa, bitsBytes);
+		bool maskOk = vc_bgr_to_mask(frame, mask1, COIN_COLORS, NCOIN_COLORS) &&
+			memcmp(mask0->data, mask1->data, (size_t)mask0->bytesperline * height) == 0;
+		bool bitsOk = vc_bgr_to_bits(frame, bits1, COIN_COLORS, NCOIN_COLORS) &&
+			memcmp(bits0->data, bits1->data, bitsBytes) == 0;
+		bool hsvOk = vc_rgb_to_hsv(frame, hsv1) &&
+			memcmp(hsv0->data, hsv1->data, (size_t)hsv0->bytesperline * height) == 0;
+
+		printf("%-24s %5dx%-5d %-7s mask %-6s bits %-6s hsv %s\n", name.c_str(), width, height, vc_simd_name(level),
+			maskOk ? "OK" : "FALHOU", bitsOk ? "OK" : "FALHOU", hsvOk ? "OK" : "FALHOU");
+		if (!maskOk || !bitsOk || !hsvOk) failed++;
+	}
+
+	vc_image_free(mask0);
+	vc_image_free(mask1);
+	vc_image_free(hsv0);
+	vc_image_free(hsv1);
+	vc_bits_free(bits0);
+	vc_bits_free(bits1);
+	return failed;
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string> images;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			usage(argv[0]);
+			return 0;
+		}
+		else if (arg == "--image" && i + 1 < argc) {
+			images.push_back(argv[++i]);
+		}
+		else {
+			std::cerr << "Opcao invalida: " << arg << "\n";
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Input> recorded;
+	for (const std::string& file : images) {
+		IVC* frame = read_frame(file.c_str());
+		if (frame == NULL) {
+			std::cerr << "Erro ao ler a imagem " << file << " (PPM a cores)\n";
+			return 1;
+		}
+		recorded.push_back({ file, frame });
+	}
+
+	int best = vc_simd_detect();
+	int previous = vc_simd_level();
+	printf("simd: %s\n", vc_simd_name(best));
+	if (best == VC_SIMD_NONE) std::cout << "Sem instrucoes SIMD neste processador\n";
+
+	int failed = 0, nframes = 0;
+	for (const auto& size : SIZES) {
+		std::vector<Input> inputs = {
+			{ "synthetic", synthetic_frame(size[0], size[1]) },
+			{ "noise", noise_frame(size[0], size[1], 1u + size[0] * 7919u + size[1]) },
+		};
+		for (const Input& input : recorded) inputs.push_back({ input.name, tiled_frame(input.frame, size[0], size[1]) });
+		for (Input& input : inputs) {
+			if (input.frame == NULL) {
+				std::cerr << "Sem memoria para " << size[0] << "x" << size[1] << "\n";
+				return 1;
+			}
+			failed += check_frame(input.name, input.frame, best);
+			nframes++;
+			vc_image_free(input.frame);
+		}
+	}
+	// The recorded frames at their own size
+	for (Input& input : recorded) {
+		failed += check_frame(input.name, input.frame, best);
+		nframes++;
+		vc_image_free(input.frame);
+	}
+	vc_simd_set_level(previous);
+
+	std::cout << "Frames : " << nframes << ", " << (failed == 0 ? "OK" : "FALHOU") << " (" << failed << " diferentes)\n";
+	return failed == 0 ? 0 : 1;
+}
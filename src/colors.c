@@ -41,6 +41,54 @@ int vc_gbr_rgb(IVC* src) {
 	return 1;
 }
 
+/// <summary>
+/// Converts one RGB pixel to HSV, scaled to [0, 255] exactly as vc_rgb_to_hsv does.
+/// </summary>
+/// <param name="r">Red value</param>
+/// <param name="g">Green value</param>
+/// <param name="b">Blue value</param>
+/// <param name="hsv">Output H, S and V bytes</param>
+static void vc_pixel_rgb_to_hsv(int r, int g, int b, unsigned char* hsv) {
+	float max, min, h, s, v;
+
+	max = MAX3(r, g, b);
+	min = MIN3(r, g, b);
+	if (max == 0) {
+		hsv[0] = 0;
+		hsv[1] = 0;
+		hsv[2] = 0;
+		return;
+	}
+	v = max;
+	if (max == min) {
+		hsv[0] = 0;
+		hsv[1] = 0;
+		hsv[2] = v;
+		return;
+	}
+	s = (max - min) / v;
+	if (r == max) {
+		if (g >= b) {
+			h = 60 * (g - b) / (max - min);
+		}
+		else {
+			h = 360 + 60 * (g - b) / (max - min);
+		}
+	}
+	else if (g == max) {
+		h = 120 + 60 * (b - r) / (max - min);
+	}
+	else {
+		h = 240 + 60 * (r - g) / (max - min);
+	}
+	h = (h / 360) * 255;
+	hsv[0] = h;
+	hsv[1] = s * 255;
+	hsv[2] = v;
+}
+
+static void vc_hsv_range_bytes(const HSVRANGE* ranges, int nranges, unsigned char* lo, unsigned char* hi);
+
 /// <summary>
 /// Converts an image from RGB color space to HSV (Hue, Saturation, Value) color space.
 /// The resulting HSV values are scaled to the range [0, 255].
@@ -53,57 +101,18 @@ int vc_rgb_to_hsv(IVC* src, IVC* dst) {
 	int height = src->height;
 	int bytesperline = src->bytesperline;
 	int channels = src->channels;
-	int x, y, a, b, c;
-	long int pos1, pos2, pos3;
-	float max, min, h, s, v;
+	int x, y;
+	long int pos1;
 
 	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
 	if (channels != 3)return 0;
 
 	for (y = 0; y < height; y++) {
-		for (x = 0; x < width; x++) {
+		// SIMD kernels for most of the row, the scalar code for the rest
+		x = vc_simd_hsv_row(src->data + y * bytesperline, width, 0, dst->data + y * bytesperline);
+		for (; x < width; x++) {
 			pos1 = y * bytesperline + x * channels;
-			pos2 = pos1 + 1;
-			pos3 = pos1 + 2;
-			a = src->data[pos1];
-			b = src->data[pos2];
-			c = src->data[pos3];
-			max = MAX3(src->data[pos1], src->data[pos2], src->data[pos3]);
-			min = MIN3(src->data[pos1], src->data[pos2], src->data[pos3]);
-			if (max == 0) {
-				dst->data[pos1] = 0;
-				dst->data[pos2] = 0;
-				dst->data[pos3] = 0;
-				continue;
-			}
-			v = max;
-			if (max == min) {
-				s = 0;
-				h = 0;
-				dst->data[pos1] = h;
-				dst->data[pos2] = s;
-				dst->data[pos3] = v;
-				continue;
-			}
-			s = (max - min) / v;
-			if (src->data[pos1] == max) {
-				if (src->data[pos2] >= src->data[pos3]) {
-					h = 60 * (src->data[pos2] - src->data[pos3]) / (max - min);
-				}
-				else {
-					h = 360 + 60 * (src->data[pos2] - src->data[pos3]) / (max - min);
-				}
-			}
-			else if (src->data[pos2] == max) {
-				h = 120 + 60 * (src->data[pos3] - src->data[pos1]) / (max - min);
-			}
-			else if (src->data[pos3] == max) {
-				h = 240 + 60 * (src->data[pos1] - src->data[pos2]) / (max - min);
-			}
-			h = (h / 360) * 255;
-			dst->data[pos1] = h;
-			dst->data[pos2] = s * 255;
-			dst->data[pos3] = v;
+			vc_pixel_rgb_to_hsv(src->data[pos1], src->data[pos1 + 1], src->data[pos1 + 2], &dst->data[pos1]);
 		}
 	}
 	return 1;
@@ -130,24 +139,23 @@ int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int sm
 	int channels = src->channels;
 	int x, y;
 	long int pos1, pos2;
+	HSVRANGE range = { hmin, hmax, smin, smax, vmin, vmax };
+	unsigned char lo[3], hi[3];
 
 
 	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
 	if (channels != 3)return 0;
 
+	// The float scaling is monotonic, so the range is a byte interval per channel
+	vc_hsv_range_bytes(&range, 1, lo, hi);
+
 	for (y = 0; y < height; y++) {
 		for (x = 0; x < width; x++) {
 			pos1 = y * bytesperline + x * channels;
 			//pos2 = y * bpl + x * 1;
 
-			float fhmin = src->data[pos1] / 255.0f * 360;
-			float fhmax = src->data[pos1] / 255.0f * 360;
-			float fsmin = src->data[pos1 + 1] / 255.0f * 100;
-			float fsmax = src->data[pos1 + 1] / 255.0f * 100;
-			float fvmin = src->data[pos1 + 2] / 255.0f * 100;
-			float fvmax = src->data[pos1 + 2] / 255.0f * 100;
-
-			if (fhmin >= hmin && fhmax <= hmax && fsmin >= smin && fsmax <= smax && fvmin >= vmin && fvmax <= vmax) {
+			if (src->data[pos1] >= lo[0] && src->data[pos1] <= hi[0] && src->data[pos1 + 1] >= lo[1] && src->data[pos1 + 1] <= hi[1] &&
+				src->data[pos1 + 2] >= lo[2] && src->data[pos1 + 2] <= hi[2]) {
 				dst->data[pos1] = 255;
 				dst->data[pos1 + 1] = 255;
 				dst->data[pos1 + 2] = 255;
@@ -160,3 +168,628 @@ int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int sm
 	}
 	return 1;
 }
+
+/// <summary>
+/// Builds, for every possible H, S and V byte, the bitmask of the ranges that accept it.
+/// Uses the same float scaling as vc_hsv_segmentation, so both give the same result.
+/// </summary>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (at most 32).</param>
+/// <param name="hbits">Output: 256 bitmasks for H.</param>
+/// <param name="sbits">Output: 256 bitmasks for S.</param>
+/// <param name="vbits">Output: 256 bitmasks for V.</param>
+static void vc_hsv_range_bits(const HSVRANGE* ranges, int nranges, unsigned int* hbits, unsigned int* sbits, unsigned int* vbits) {
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		float fh = i / 255.0f * 360;
+		float fs = i / 255.0f * 100;
+		float fv = i / 255.0f * 100;
+
+		hbits[i] = 0;
+		sbits[i] = 0;
+		vbits[i] = 0;
+		for (k = 0; k < nranges; k++) {
+			if (fh >= ranges[k].hmin && fh <= ranges[k].hmax) hbits[i] |= 1u << k;
+			if (fs >= ranges[k].smin && fs <= ranges[k].smax) sbits[i] |= 1u << k;
+			if (fv >= ranges[k].vmin && fv <= ranges[k].vmax) vbits[i] |= 1u << k;
+		}
+	}
+}
+
+/// <summary>
+/// Byte interval [lo, hi] of H, S and V accepted by each range (lo > hi when the
+/// channel accepts no value). The tests of vc_hsv_range_bits are monotonic in
+/// the byte, so every range accepts one interval per channel.
+/// </summary>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (at most 32).</param>
+/// <param name="lo">Output: 3 * nranges lower bounds (H, S, V of each range).</param>
+/// <param name="hi">Output: 3 * nranges upper bounds.</param>
+static void vc_hsv_range_bytes(const HSVRANGE* ranges, int nranges, unsigned char* lo, unsigned char* hi) {
+	unsigned int bits[3][256];
+	int i, k, c;
+
+	vc_hsv_range_bits(ranges, nranges, bits[0], bits[1], bits[2]);
+	for (k = 0; k < nranges; k++) {
+		for (c = 0; c < 3; c++) {
+			lo[3 * k + c] = 255;
+			hi[3 * k + c] = 0;
+			for (i = 255; i >= 0; i--) if (bits[c][i] & (1u << k)) lo[3 * k + c] = (unsigned char)i;
+			for (i = 0; i < 256; i++) if (bits[c][i] & (1u << k)) hi[3 * k + c] = (unsigned char)i;
+		}
+	}
+}
+
+/// <summary>
+/// Segments a BGR image against a list of HSV ranges in a single pass.
+/// Equivalent to vc_gbr_rgb + vc_rgb_to_hsv + one vc_hsv_segmentation per range
+/// + vc_add_image + vc_three_to_one_channel, without touching src and without
+/// any intermediate image: a pixel is white (255) if it is inside any range.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels), e.g. a decoded video frame.</param>
+/// <param name="dst">Destination binary image (1 channel, same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_mask(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int bpl = dst->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char lo[3 * 32], hi[3 * 32];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	unsigned char* pd;
+	int x, y;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits(ranges, nranges, hbits, sbits, vbits);
+	vc_hsv_range_bytes(ranges, nranges, lo, hi);
+
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		pd = dst->data + y * bpl;
+		// SIMD kernels for most of the row, the scalar code for the rest
+		x = vc_simd_mask_row(ps, width, 1, lo, hi, nranges, pd);
+		for (ps += 3 * x; x < width; x++, ps += 3) {
+			vc_pixel_rgb_to_hsv(ps[2], ps[1], ps[0], hsv);
+			pd[x] = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) ? 255 : 0;
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Creates an empty colour lookup table for HSV segmentation.
+/// The table is indexed by the colour quantised to bits/3 bits per channel:
+/// 24 bits is exact (16 MB), 21 bits takes 2 MB and 18 bits 256 KB.
+/// </summary>
+/// <param name="bits">Bits of the index: 24, 21 or 18.</param>
+/// <returns>Pointer to the new table, or NULL on error.</returns>
+HSVLUT* vc_hsv_lut_new(int bits) {
+	HSVLUT* lut;
+
+	if ((bits != 24) && (bits != 21) && (bits != 18)) return NULL;
+
+	lut = (HSVLUT*)malloc(sizeof(HSVLUT));
+	if (lut == NULL) return NULL;
+
+	lut->bits = bits / 3;
+	lut->nranges = 0;
+	lut->table = (unsigned char*)calloc((size_t)1 << bits, sizeof(unsigned char));
+	if (lut->table == NULL) {
+		free(lut);
+		return NULL;
+	}
+	return lut;
+}
+
+HSVLUT* vc_hsv_lut_free(HSVLUT* lut) {
+	if (lut != NULL) {
+		free(lut->table);
+		free(lut);
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Sets the HSV ranges of the table. The table is only rebuilt when the ranges
+/// differ from the ones it was built with. Entry bit k is set when the colour
+/// is inside range k. Quantised tables classify each cell by its centre colour.
+/// </summary>
+/// <param name="lut">Lookup table.</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 8).</param>
+/// <returns>1 if the table was rebuilt, 2 if it was already up to date, 0 on error.</returns>
+int vc_hsv_lut_set(HSVLUT* lut, const HSVRANGE* ranges, int nranges) {
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char hsv[3];
+	unsigned char* p;
+	int bits, shift, half, n;
+	int r, g, b;
+
+	if ((lut == NULL) || (ranges == NULL)) return 0;
+	if ((nranges < 1) || (nranges > VC_LUT_MAX_RANGES)) return 0;
+
+	if ((nranges == lut->nranges) && (memcmp(ranges, lut->ranges, nranges * sizeof(HSVRANGE)) == 0)) return 2;
+
+	vc_hsv_range_bits(ranges, nranges, hbits, sbits, vbits);
+
+	bits = lut->bits;
+	shift = 8 - bits;
+	half = shift > 0 ? 1 << (shift - 1) : 0;
+	n = 1 << bits;
+	p = lut->table;
+	for (r = 0; r < n; r++) {
+		for (g = 0; g < n; g++) {
+			for (b = 0; b < n; b++) {
+				vc_pixel_rgb_to_hsv((r << shift) | half, (g << shift) | half, (b << shift) | half, hsv);
+				*p++ = (unsigned char)(hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]);
+			}
+		}
+	}
+
+	memcpy(lut->ranges, ranges, nranges * sizeof(HSVRANGE));
+	lut->nranges = nranges;
+	return 1;
+}
+
+/// <summary>
+/// Segments a BGR image with a lookup table built by vc_hsv_lut_set: one table
+/// load per pixel. With a 24 bit table the result equals vc_bgr_to_mask.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination binary image (1 channel, same size as src).</param>
+/// <param name="lut">Lookup table.</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_mask_lut(IVC* src, IVC* dst, const HSVLUT* lut) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int bpl = dst->bytesperline;
+	const unsigned char* table;
+	unsigned char* ps;
+	unsigned char* pd;
+	int bits, shift;
+	int x, y;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((lut == NULL) || (lut->nranges == 0)) return 0;
+
+	table = lut->table;
+	bits = lut->bits;
+	shift = 8 - bits;
+
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		pd = dst->data + y * bpl;
+		for (x = 0; x < width; x++, ps += 3) {
+			long int idx = ((long int)(ps[2] >> shift) << (2 * bits)) | ((ps[1] >> shift) << bits) | (ps[0] >> shift);
+			pd[x] = table[idx] ? 255 : 0;
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask, written straight to runs: no mask is
+/// written, only the start and end of every white run.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination run-length encoded image (same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_rle(IVC* src, RVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char lo[3 * 32], hi[3 * 32];
+	unsigned char row[4096];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	int x, y, x0, in, nsimd;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits(ranges, nranges, hbits, sbits, vbits);
+	vc_hsv_range_bytes(ranges, nranges, lo, hi);
+
+	dst->nruns = 0;
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		// The SIMD kernels classify the row into a buffer (rows up to 4096 pixels)
+		nsimd = width <= (int)sizeof(row) ? vc_simd_mask_row(ps, width, 1, lo, hi, nranges, row) : 0;
+		dst->row[y] = dst->nruns;
+		x0 = -1;
+		for (x = 0; x < width; x++, ps += 3) {
+			if (x < nsimd) in = row[x] != 0;
+			else {
+				vc_pixel_rgb_to_hsv(ps[2], ps[1], ps[0], hsv);
+				in = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) != 0;
+			}
+			if (in && (x0 < 0)) x0 = x;
+			else if (!in && (x0 >= 0)) {
+				if (!vc_rle_add_run(dst, x0, x)) return 0;
+				x0 = -1;
+			}
+		}
+		if ((x0 >= 0) && !vc_rle_add_run(dst, x0, width)) return 0;
+	}
+	dst->row[height] = dst->nruns;
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask_lut, written straight to runs.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination run-length encoded image (same size as src).</param>
+/// <param name="lut">Lookup table.</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_rle_lut(IVC* src, RVC* dst, const HSVLUT* lut) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	const unsigned char* table;
+	unsigned char* ps;
+	int bits, shift;
+	int x, y, x0, in;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((lut == NULL) || (lut->nranges == 0)) return 0;
+
+	table = lut->table;
+	bits = lut->bits;
+	shift = 8 - bits;
+
+	dst->nruns = 0;
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		dst->row[y] = dst->nruns;
+		x0 = -1;
+		for (x = 0; x < width; x++, ps += 3) {
+			long int idx = ((long int)(ps[2] >> shift) << (2 * bits)) | ((ps[1] >> shift) << bits) | (ps[0] >> shift);
+			in = table[idx] != 0;
+			if (in && (x0 < 0)) x0 = x;
+			else if (!in && (x0 >= 0)) {
+				if (!vc_rle_add_run(dst, x0, x)) return 0;
+				x0 = -1;
+			}
+		}
+		if ((x0 >= 0) && !vc_rle_add_run(dst, x0, width)) return 0;
+	}
+	dst->row[height] = dst->nruns;
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask, written straight to a packed mask:
+/// every chunk of up to 4096 pixels is classified into a row buffer on the
+/// stack and packed, so no byte mask of the image is written.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination packed mask (same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_bits(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char lo[3 * 32], hi[3 * 32];
+	unsigned char row[4096];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	int x, y, x0, n;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits(ranges, nranges, hbits, sbits, vbits);
+	vc_hsv_range_bytes(ranges, nranges, lo, hi);
+
+	for (y = 0; y < height; y++) {
+		for (x0 = 0; x0 < width; x0 += (int)sizeof(row)) {
+			n = width - x0 < (int)sizeof(row) ? width - x0 : (int)sizeof(row);
+			ps = src->data + y * bytesperline + 3 * x0;
+			x = vc_simd_mask_row(ps, n, 1, lo, hi, nranges, row);
+			for (ps += 3 * x; x < n; x++, ps += 3) {
+				vc_pixel_rgb_to_hsv(ps[2], ps[1], ps[0], hsv);
+				row[x] = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) ? 255 : 0;
+			}
+			vc_bits_pack_row(row, n, dst->data + (size_t)y * dst->words + x0 / 64);
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask_lut, written straight to a packed mask.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination packed mask (same size as src).</param>
+/// <param name="lut">Lookup table.</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_bits_lut(IVC* src, BVC* dst, const HSVLUT* lut) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	const unsigned char* table;
+	unsigned char row[4096];
+	unsigned char* ps;
+	int bits, shift;
+	int x, y, x0, n;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((lut == NULL) || (lut->nranges == 0)) return 0;
+
+	table = lut->table;
+	bits = lut->bits;
+	shift = 8 - bits;
+
+	for (y = 0; y < height; y++) {
+		for (x0 = 0; x0 < width; x0 += (int)sizeof(row)) {
+			n = width - x0 < (int)sizeof(row) ? width - x0 : (int)sizeof(row);
+			ps = src->data + y * bytesperline + 3 * x0;
+			for (x = 0; x < n; x++, ps += 3) {
+				long int idx = ((long int)(ps[2] >> shift) << (2 * bits)) | ((ps[1] >> shift) << bits) | (ps[0] >> shift);
+				row[x] = table[idx];
+			}
+			vc_bits_pack_row(row, n, dst->data + (size_t)y * dst->words + x0 / 64);
+		}
+	}
+	return 1;
+}
+
+// ceil(2^24 / d): n * vc_recip[d] >> 24 equals n / d for n < 2^16 and d < 256
+static const unsigned int vc_recip[256] = {
+	0, 16777216, 8388608, 5592406, 4194304, 3355444, 2796203, 2396746,
+	2097152, 1864136, 1677722, 1525202, 1398102, 1290556, 1198373, 1118482,
+	1048576, 986896, 932068, 883012, 838861, 798916, 762601, 729445,
+	699051, 671089, 645278, 621379, 599187, 578525, 559241, 541201,
+	524288, 508401, 493448, 479350, 466034, 453439, 441506, 430186,
+	419431, 409201, 399458, 390168, 381301, 372828, 364723, 356963,
+	349526, 342393, 335545, 328966, 322639, 316552, 310690, 305041,
+	299594, 294338, 289263, 284360, 279621, 275037, 270601, 266306,
+	262144, 258112, 254201, 250407, 246724, 243149, 239675, 236299,
+	233017, 229825, 226720, 223697, 220753, 217886, 215093, 212370,
+	209716, 207127, 204601, 202136, 199729, 197380, 195084, 192842,
+	190651, 188509, 186414, 184366, 182362, 180401, 178482, 176603,
+	174763, 172961, 171197, 169467, 167773, 166112, 164483, 162886,
+	161320, 159784, 158276, 156797, 155345, 153920, 152521, 151147,
+	149797, 148471, 147169, 145889, 144632, 143396, 142180, 140986,
+	139811, 138655, 137519, 136401, 135301, 134218, 133153, 132105,
+	131072, 130056, 129056, 128071, 127101, 126145, 125204, 124276,
+	123362, 122462, 121575, 120700, 119838, 118988, 118150, 117324,
+	116509, 115705, 114913, 114131, 113360, 112599, 111849, 111108,
+	110377, 109656, 108943, 108241, 107547, 106862, 106185, 105518,
+	104858, 104207, 103564, 102928, 102301, 101681, 101068, 100463,
+	99865, 99274, 98690, 98113, 97542, 96979, 96421, 95870,
+	95326, 94787, 94255, 93728, 93207, 92692, 92183, 91679,
+	91181, 90688, 90201, 89718, 89241, 88769, 88302, 87839,
+	87382, 86929, 86481, 86038, 85599, 85164, 84734, 84308,
+	83887, 83469, 83056, 82647, 82242, 81841, 81443, 81050,
+	80660, 80274, 79892, 79513, 79138, 78767, 78399, 78034,
+	77673, 77315, 76960, 76609, 76261, 75916, 75574, 75235,
+	74899, 74566, 74236, 73909, 73585, 73263, 72945, 72629,
+	72316, 72006, 71698, 71393, 71090, 70790, 70493, 70198,
+	69906, 69616, 69328, 69043, 68760, 68479, 68201, 67924,
+	67651, 67379, 67109, 66842, 66577, 66314, 66053, 65794,
+};
+
+/// <summary>
+/// Integer-only RGB to HSV, scaled to [0, 255]: H = floor(h / 360 * 255),
+/// S = floor((max - min) / max * 255), V = max, with the divisions by max - min
+/// and by max done with vc_recip. S and V equal vc_pixel_rgb_to_hsv; H is one
+/// more for about 0.2% of the colours, where the float code rounds down.
+/// </summary>
+/// <param name="r">Red value</param>
+/// <param name="g">Green value</param>
+/// <param name="b">Blue value</param>
+/// <param name="hsv">Output H, S and V bytes</param>
+static void vc_pixel_rgb_to_hsv_fixed(int r, int g, int b, unsigned char* hsv) {
+	int max = MAX3(r, g, b);
+	int min = MIN3(r, g, b);
+	int d = max - min;
+	unsigned int n;
+
+	if (d == 0) {
+		hsv[0] = 0;
+		hsv[1] = 0;
+		hsv[2] = (unsigned char)max;
+		return;
+	}
+	// Hue in 1/d degrees
+	if (r == max) n = g >= b ? 60 * (g - b) : 360 * d - 60 * (b - g);
+	else if (g == max) n = 120 * d + 60 * (b - r);
+	else n = 240 * d + 60 * (r - g);
+	// h / 360 * 255 = n * 17 / 24 / d (n * 17 / 24 < 2^16)
+	hsv[0] = (unsigned char)(((unsigned long long)(n * 17 / 24) * vc_recip[d]) >> 24);
+	hsv[1] = (unsigned char)(((unsigned long long)(255 * d) * vc_recip[max]) >> 24);
+	hsv[2] = (unsigned char)max;
+}
+
+/// <summary>
+/// Same as vc_hsv_range_bits, with the range limits compared to the H, S and V
+/// bytes in integers (byte * 360 >= hmin * 255, ...).
+/// </summary>
+static void vc_hsv_range_bits_fixed(const HSVRANGE* ranges, int nranges, unsigned int* hbits, unsigned int* sbits, unsigned int* vbits) {
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		hbits[i] = 0;
+		sbits[i] = 0;
+		vbits[i] = 0;
+		for (k = 0; k < nranges; k++) {
+			if (i * 360 >= ranges[k].hmin * 255 && i * 360 <= ranges[k].hmax * 255) hbits[i] |= 1u << k;
+			if (i * 100 >= ranges[k].smin * 255 && i * 100 <= ranges[k].smax * 255) sbits[i] |= 1u << k;
+			if (i * 100 >= ranges[k].vmin * 255 && i * 100 <= ranges[k].vmax * 255) vbits[i] |= 1u << k;
+		}
+	}
+}
+
+/// <summary>
+/// Same as vc_rgb_to_hsv without floating point: the result does not depend on
+/// the compiler nor on the optimisation level.
+/// </summary>
+/// <param name="src">Source image in RGB order (3 channels).</param>
+/// <param name="dst">Destination image (3 channels, same size as src).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_rgb_to_hsv_fixed(IVC* src, IVC* dst) {
+	int x, y;
+	unsigned char* ps;
+	unsigned char* pd;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 3)) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		ps = src->data + y * src->bytesperline;
+		pd = dst->data + y * dst->bytesperline;
+		for (x = 0; x < src->width; x++, ps += 3, pd += 3) {
+			vc_pixel_rgb_to_hsv_fixed(ps[0], ps[1], ps[2], pd);
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same as vc_bgr_to_mask with the integer HSV conversion and thresholds.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination binary image (1 channel, same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_mask_fixed(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int bpl = dst->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	unsigned char* pd;
+	int x, y;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits_fixed(ranges, nranges, hbits, sbits, vbits);
+
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		pd = dst->data + y * bpl;
+		for (x = 0; x < width; x++, ps += 3) {
+			vc_pixel_rgb_to_hsv_fixed(ps[2], ps[1], ps[0], hsv);
+			pd[x] = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) ? 255 : 0;
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask_fixed, written straight to runs.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination run-length encoded image (same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_rle_fixed(IVC* src, RVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	int x, y, x0, in;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits_fixed(ranges, nranges, hbits, sbits, vbits);
+
+	dst->nruns = 0;
+	for (y = 0; y < height; y++) {
+		ps = src->data + y * bytesperline;
+		dst->row[y] = dst->nruns;
+		x0 = -1;
+		for (x = 0; x < width; x++, ps += 3) {
+			vc_pixel_rgb_to_hsv_fixed(ps[2], ps[1], ps[0], hsv);
+			in = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) != 0;
+			if (in && (x0 < 0)) x0 = x;
+			else if (!in && (x0 >= 0)) {
+				if (!vc_rle_add_run(dst, x0, x)) return 0;
+				x0 = -1;
+			}
+		}
+		if ((x0 >= 0) && !vc_rle_add_run(dst, x0, width)) return 0;
+	}
+	dst->row[height] = dst->nruns;
+	return 1;
+}
+
+/// <summary>
+/// Same segmentation as vc_bgr_to_mask_fixed, written straight to a packed mask.
+/// </summary>
+/// <param name="src">Source image in BGR order (3 channels).</param>
+/// <param name="dst">Destination packed mask (same size as src).</param>
+/// <param name="ranges">HSV ranges (H in [0, 360], S and V in [0, 100]).</param>
+/// <param name="nranges">Number of ranges (1 to 32).</param>
+/// <returns>1 if successful, 0 if an error occurs.</returns>
+int vc_bgr_to_bits_fixed(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges) {
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	unsigned int hbits[256], sbits[256], vbits[256];
+	unsigned char row[4096];
+	unsigned char hsv[3];
+	unsigned char* ps;
+	int x, y, x0, n;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if (src->channels != 3) return 0;
+	if ((nranges < 1) || (nranges > 32)) return 0;
+
+	vc_hsv_range_bits_fixed(ranges, nranges, hbits, sbits, vbits);
+
+	for (y = 0; y < height; y++) {
+		for (x0 = 0; x0 < width; x0 += (int)sizeof(row)) {
+			n = width - x0 < (int)sizeof(row) ? width - x0 : (int)sizeof(row);
+			ps = src->data + y * bytesperline + 3 * x0;
+			for (x = 0; x < n; x++, ps += 3) {
+				vc_pixel_rgb_to_hsv_fixed(ps[2], ps[1], ps[0], hsv);
+				row[x] = (hbits[hsv[0]] & sbits[hsv[1]] & vbits[hsv[2]]) != 0;
+			}
+			vc_bits_pack_row(row, n, dst->data + (size_t)y * dst->words + x0 / 64);
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,447 @@
+/*****************************************************************//**
+ * \file   colors_simd.c
+ * \brief  SSE4.1, AVX2 and AVX-512 versions of the RGB to HSV conversion
+ *         and of the HSV range test, chosen at run time from CPUID.
+ *
+ * The kernels repeat the float operations of the scalar conversion in the
+ * same order, so their results are bit-exact; the scalar code in colors.c
+ * stays the reference and handles the pixels left at the end of a row.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include "vc.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VC_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(VC_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VC_TARGET(isa)
+#endif
+
+static const char* vc_simd_names[] = { "none", "sse4.1", "avx2", "avx512" };
+
+// -1 until vc_simd_set_level or the first call to vc_simd_level
+static int vc_simd_current = -1;
+
+/// <summary>
+/// Best instruction set supported by both this build and the CPU.
+/// </summary>
+/// <returns>VC_SIMD_NONE, VC_SIMD_SSE41, VC_SIMD_AVX2 or VC_SIMD_AVX512</returns>
+int vc_simd_detect(void) {
+#if defined(VC_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return VC_SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2")) return VC_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.1")) return VC_SIMD_SSE41;
+	return VC_SIMD_NONE;
+#elif defined(VC_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	int level = VC_SIMD_NONE;
+	unsigned long long xcr0 = 0;
+
+	__cpuid(info, 1);
+	if (info[2] & (1 << 19)) level = VC_SIMD_SSE41;
+	// AVX state must be enabled by the OS (OSXSAVE and XCR0)
+	if (info[2] & (1 << 27)) xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	if (((xcr0 & 0x6) == 0x6) && (info[1] & (1 << 5))) level = VC_SIMD_AVX2;
+	if (((xcr0 & 0xe6) == 0xe6) && (info[1] & (1 << 16))) level = VC_SIMD_AVX512;
+	return level;
+#else
+	return VC_SIMD_NONE;
+#endif
+}
+
+/// <summary>
+/// Instruction set used by the colour kernels. Detected on the first call if
+/// vc_simd_set_level was not called, which is not thread safe: programs that run
+/// the kernels on several threads select the level before starting them.
+/// </summary>
+int vc_simd_level(void) {
+	if (vc_simd_current < 0) vc_simd_current = vc_simd_detect();
+	return vc_simd_current;
+}
+
+/// <summary>
+/// Selects the instruction set of the colour kernels, e.g. VC_SIMD_NONE for the
+/// scalar reference. Levels above vc_simd_detect() are lowered to it. Not
+/// thread safe: call it before starting the processing threads.
+/// </summary>
+/// <returns>Level actually selected</returns>
+int vc_simd_set_level(int level) {
+	int best = vc_simd_detect();
+
+	if (level < VC_SIMD_NONE) level = VC_SIMD_NONE;
+	vc_simd_current = level > best ? best : level;
+	return vc_simd_current;
+}
+
+const char* vc_simd_name(int level) {
+	if ((level < VC_SIMD_NONE) || (level > VC_SIMD_AVX512)) return "?";
+	return vc_simd_names[level];
+}
+
+#ifdef VC_SIMD_X86
+
+// pshufb masks: [channel][load] picks byte 3i + channel of 16 pixels (0x80 = zero)
+static const unsigned char vc_deinterleave_masks[3][3][16] = {
+	{
+		{ 0x00, 0x03, 0x06, 0x09, 0x0c, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02, 0x05, 0x08, 0x0b, 0x0e, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0x04, 0x07, 0x0a, 0x0d },
+	},
+	{
+		{ 0x01, 0x04, 0x07, 0x0a, 0x0d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x03, 0x06, 0x09, 0x0c, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02, 0x05, 0x08, 0x0b, 0x0e },
+	},
+	{
+		{ 0x02, 0x05, 0x08, 0x0b, 0x0e, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0x04, 0x07, 0x0a, 0x0d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x03, 0x06, 0x09, 0x0c, 0x0f },
+	},
+};
+
+// pshufb masks: [output block][channel] places channel byte q / 3 at byte q % 3 == channel
+static const unsigned char vc_interleave_masks[3][3][16] = {
+	{
+		{ 0x00, 0x80, 0x80, 0x01, 0x80, 0x80, 0x02, 0x80, 0x80, 0x03, 0x80, 0x80, 0x04, 0x80, 0x80, 0x05 },
+		{ 0x80, 0x00, 0x80, 0x80, 0x01, 0x80, 0x80, 0x02, 0x80, 0x80, 0x03, 0x80, 0x80, 0x04, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x00, 0x80, 0x80, 0x01, 0x80, 0x80, 0x02, 0x80, 0x80, 0x03, 0x80, 0x80, 0x04, 0x80 },
+	},
+	{
+		{ 0x80, 0x80, 0x06, 0x80, 0x80, 0x07, 0x80, 0x80, 0x08, 0x80, 0x80, 0x09, 0x80, 0x80, 0x0a, 0x80 },
+		{ 0x05, 0x80, 0x80, 0x06, 0x80, 0x80, 0x07, 0x80, 0x80, 0x08, 0x80, 0x80, 0x09, 0x80, 0x80, 0x0a },
+		{ 0x80, 0x05, 0x80, 0x80, 0x06, 0x80, 0x80, 0x07, 0x80, 0x80, 0x08, 0x80, 0x80, 0x09, 0x80, 0x80 },
+	},
+	{
+		{ 0x80, 0x0b, 0x80, 0x80, 0x0c, 0x80, 0x80, 0x0d, 0x80, 0x80, 0x0e, 0x80, 0x80, 0x0f, 0x80, 0x80 },
+		{ 0x80, 0x80, 0x0b, 0x80, 0x80, 0x0c, 0x80, 0x80, 0x0d, 0x80, 0x80, 0x0e, 0x80, 0x80, 0x0f, 0x80 },
+		{ 0x0a, 0x80, 0x80, 0x0b, 0x80, 0x80, 0x0c, 0x80, 0x80, 0x0d, 0x80, 0x80, 0x0e, 0x80, 0x80, 0x0f },
+	},
+};
+
+// Splits 16 interleaved pixels into one vector per channel
+VC_TARGET("sse4.1")
+static void vc_deinterleave16(const unsigned char* src, __m128i* c0, __m128i* c1, __m128i* c2) {
+	__m128i a = _mm_loadu_si128((const __m128i*)src);
+	__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+	__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+	__m128i* out[3];
+	int k;
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	for (k = 0; k < 3; k++) {
+		__m128i x = _mm_shuffle_epi8(a, _mm_loadu_si128((const __m128i*)vc_deinterleave_masks[k][0]));
+		x = _mm_or_si128(x, _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i*)vc_deinterleave_masks[k][1])));
+		x = _mm_or_si128(x, _mm_shuffle_epi8(c, _mm_loadu_si128((const __m128i*)vc_deinterleave_masks[k][2])));
+		*out[k] = x;
+	}
+}
+
+// Writes 16 pixels from one vector per channel
+VC_TARGET("sse4.1")
+static void vc_interleave16(unsigned char* dst, __m128i c0, __m128i c1, __m128i c2) {
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		__m128i x = _mm_shuffle_epi8(c0, _mm_loadu_si128((const __m128i*)vc_interleave_masks[j][0]));
+		x = _mm_or_si128(x, _mm_shuffle_epi8(c1, _mm_loadu_si128((const __m128i*)vc_interleave_masks[j][1])));
+		x = _mm_or_si128(x, _mm_shuffle_epi8(c2, _mm_loadu_si128((const __m128i*)vc_interleave_masks[j][2])));
+		_mm_storeu_si128((__m128i*)(dst + 16 * j), x);
+	}
+}
+
+// 255 where the pixel is inside any range (bytes lo <= x <= hi per channel)
+VC_TARGET("sse4.1")
+static __m128i vc_ranges16(__m128i h, __m128i s, __m128i v, const unsigned char* lo, const unsigned char* hi, int nranges) {
+	__m128i in = _mm_setzero_si128();
+	int k;
+
+	for (k = 0; k < nranges; k++) {
+		__m128i ok = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(h, _mm_set1_epi8((char)lo[3 * k])), h),
+			_mm_cmpeq_epi8(_mm_min_epu8(h, _mm_set1_epi8((char)hi[3 * k])), h));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(s, _mm_set1_epi8((char)lo[3 * k + 1])), s));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_min_epu8(s, _mm_set1_epi8((char)hi[3 * k + 1])), s));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8((char)lo[3 * k + 2])), v));
+		ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8((char)hi[3 * k + 2])), v));
+		in = _mm_or_si128(in, ok);
+	}
+	return in;
+}
+
+#pragma region SSE4.1
+
+// HSV of 4 pixels (32-bit lanes), as vc_pixel_rgb_to_hsv
+VC_TARGET("sse4.1")
+static void vc_hsv4_sse41(__m128i r, __m128i g, __m128i b, __m128i* h, __m128i* s) {
+	__m128i mx = _mm_max_epi32(_mm_max_epi32(r, g), b);
+	__m128i mn = _mm_min_epi32(_mm_min_epi32(r, g), b);
+	__m128i d = _mm_sub_epi32(mx, mn);
+	__m128i isr = _mm_cmpeq_epi32(r, mx);
+	__m128i isg = _mm_andnot_si128(isr, _mm_cmpeq_epi32(g, mx));
+	__m128i num = _mm_sub_epi32(r, g);
+	__m128 off = _mm_set1_ps(240);
+	__m128 fd = _mm_cvtepi32_ps(d);
+	__m128 fh, fs;
+	__m128i zero = _mm_cmpeq_epi32(d, _mm_setzero_si128());
+
+	num = _mm_blendv_epi8(num, _mm_sub_epi32(b, r), isg);
+	num = _mm_blendv_epi8(num, _mm_sub_epi32(g, b), isr);
+	off = _mm_blendv_ps(off, _mm_set1_ps(120), _mm_castsi128_ps(isg));
+	off = _mm_blendv_ps(off, _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(b, g)), _mm_set1_ps(360)), _mm_castsi128_ps(isr));
+
+	fh = _mm_div_ps(_mm_cvtepi32_ps(_mm_mullo_epi32(num, _mm_set1_epi32(60))), fd);
+	fh = _mm_add_ps(off, fh);
+	fh = _mm_mul_ps(_mm_div_ps(fh, _mm_set1_ps(360)), _mm_set1_ps(255));
+	fs = _mm_mul_ps(_mm_div_ps(fd, _mm_cvtepi32_ps(mx)), _mm_set1_ps(255));
+
+	// Grey pixels (max == min) have H = S = 0
+	*h = _mm_andnot_si128(zero, _mm_cvttps_epi32(fh));
+	*s = _mm_andnot_si128(zero, _mm_cvttps_epi32(fs));
+}
+
+VC_TARGET("sse4.1")
+static void vc_hsv16_sse41(__m128i r, __m128i g, __m128i b, __m128i* h, __m128i* s) {
+	__m128i hh[4], ss[4];
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		vc_hsv4_sse41(_mm_cvtepu8_epi32(r), _mm_cvtepu8_epi32(g), _mm_cvtepu8_epi32(b), &hh[k], &ss[k]);
+		r = _mm_srli_si128(r, 4);
+		g = _mm_srli_si128(g, 4);
+		b = _mm_srli_si128(b, 4);
+	}
+	*h = _mm_packus_epi16(_mm_packus_epi32(hh[0], hh[1]), _mm_packus_epi32(hh[2], hh[3]));
+	*s = _mm_packus_epi16(_mm_packus_epi32(ss[0], ss[1]), _mm_packus_epi32(ss[2], ss[3]));
+}
+
+VC_TARGET("sse4.1")
+static int vc_hsv_row_sse41(const unsigned char* src, int n, int bgr, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x;
+
+	for (x = 0; x + 16 <= n; x += 16, src += 48, dst += 48) {
+		vc_deinterleave16(src, &c0, &c1, &c2);
+		if (bgr) vc_hsv16_sse41(c2, c1, c0, &h, &s);
+		else vc_hsv16_sse41(c0, c1, c2, &h, &s);
+		vc_interleave16(dst, h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2));
+	}
+	return x;
+}
+
+VC_TARGET("sse4.1")
+static int vc_mask_row_sse41(const unsigned char* src, int n, int bgr, const unsigned char* lo, const unsigned char* hi, int nranges, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x;
+
+	for (x = 0; x + 16 <= n; x += 16, src += 48) {
+		vc_deinterleave16(src, &c0, &c1, &c2);
+		if (bgr) vc_hsv16_sse41(c2, c1, c0, &h, &s);
+		else vc_hsv16_sse41(c0, c1, c2, &h, &s);
+		_mm_storeu_si128((__m128i*)(dst + x), vc_ranges16(h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2), lo, hi, nranges));
+	}
+	return x;
+}
+
+#pragma endregion
+
+#pragma region AVX2
+
+// HSV of 8 pixels (32-bit lanes), as vc_pixel_rgb_to_hsv
+VC_TARGET("avx2")
+static void vc_hsv8_avx2(__m256i r, __m256i g, __m256i b, __m256i* h, __m256i* s) {
+	__m256i mx = _mm256_max_epi32(_mm256_max_epi32(r, g), b);
+	__m256i mn = _mm256_min_epi32(_mm256_min_epi32(r, g), b);
+	__m256i d = _mm256_sub_epi32(mx, mn);
+	__m256i isr = _mm256_cmpeq_epi32(r, mx);
+	__m256i isg = _mm256_andnot_si256(isr, _mm256_cmpeq_epi32(g, mx));
+	__m256i num = _mm256_sub_epi32(r, g);
+	__m256 off = _mm256_set1_ps(240);
+	__m256 fd = _mm256_cvtepi32_ps(d);
+	__m256 fh, fs;
+	__m256i zero = _mm256_cmpeq_epi32(d, _mm256_setzero_si256());
+
+	num = _mm256_blendv_epi8(num, _mm256_sub_epi32(b, r), isg);
+	num = _mm256_blendv_epi8(num, _mm256_sub_epi32(g, b), isr);
+	off = _mm256_blendv_ps(off, _mm256_set1_ps(120), _mm256_castsi256_ps(isg));
+	off = _mm256_blendv_ps(off, _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, g)), _mm256_set1_ps(360)), _mm256_castsi256_ps(isr));
+
+	fh = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_mullo_epi32(num, _mm256_set1_epi32(60))), fd);
+	fh = _mm256_add_ps(off, fh);
+	fh = _mm256_mul_ps(_mm256_div_ps(fh, _mm256_set1_ps(360)), _mm256_set1_ps(255));
+	fs = _mm256_mul_ps(_mm256_div_ps(fd, _mm256_cvtepi32_ps(mx)), _mm256_set1_ps(255));
+
+	*h = _mm256_andnot_si256(zero, _mm256_cvttps_epi32(fh));
+	*s = _mm256_andnot_si256(zero, _mm256_cvttps_epi32(fs));
+}
+
+// Packs 16 32-bit lanes (two vectors) to 16 bytes
+VC_TARGET("avx2")
+static __m128i vc_pack16_avx2(__m256i a, __m256i b) {
+	__m256i w = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+	return _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+VC_TARGET("avx2")
+static void vc_hsv16_avx2(__m128i r, __m128i g, __m128i b, __m128i* h, __m128i* s) {
+	__m256i h0, s0, h1, s1;
+
+	vc_hsv8_avx2(_mm256_cvtepu8_epi32(r), _mm256_cvtepu8_epi32(g), _mm256_cvtepu8_epi32(b), &h0, &s0);
+	vc_hsv8_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(r, 8)), _mm256_cvtepu8_epi32(_mm_srli_si128(g, 8)),
+		_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)), &h1, &s1);
+	*h = vc_pack16_avx2(h0, h1);
+	*s = vc_pack16_avx2(s0, s1);
+}
+
+VC_TARGET("avx2")
+static int vc_hsv_row_avx2(const unsigned char* src, int n, int bgr, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x, k;
+
+	// 32 pixels per iteration
+	for (x = 0; x + 32 <= n; x += 32) {
+		for (k = 0; k < 2; k++, src += 48, dst += 48) {
+			vc_deinterleave16(src, &c0, &c1, &c2);
+			if (bgr) vc_hsv16_avx2(c2, c1, c0, &h, &s);
+			else vc_hsv16_avx2(c0, c1, c2, &h, &s);
+			vc_interleave16(dst, h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2));
+		}
+	}
+	return x;
+}
+
+VC_TARGET("avx2")
+static int vc_mask_row_avx2(const unsigned char* src, int n, int bgr, const unsigned char* lo, const unsigned char* hi, int nranges, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x, k;
+
+	for (x = 0; x + 32 <= n; x += 32) {
+		for (k = 0; k < 2; k++, src += 48) {
+			vc_deinterleave16(src, &c0, &c1, &c2);
+			if (bgr) vc_hsv16_avx2(c2, c1, c0, &h, &s);
+			else vc_hsv16_avx2(c0, c1, c2, &h, &s);
+			_mm_storeu_si128((__m128i*)(dst + x + 16 * k), vc_ranges16(h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2), lo, hi, nranges));
+		}
+	}
+	return x;
+}
+
+#pragma endregion
+
+#pragma region AVX-512
+
+// HSV of 16 pixels, as vc_pixel_rgb_to_hsv
+VC_TARGET("avx512f")
+static void vc_hsv16_avx512(__m128i r8, __m128i g8, __m128i b8, __m128i* h, __m128i* s) {
+	__m512i r = _mm512_cvtepu8_epi32(r8);
+	__m512i g = _mm512_cvtepu8_epi32(g8);
+	__m512i b = _mm512_cvtepu8_epi32(b8);
+	__m512i mx = _mm512_max_epi32(_mm512_max_epi32(r, g), b);
+	__m512i d = _mm512_sub_epi32(mx, _mm512_min_epi32(_mm512_min_epi32(r, g), b));
+	__mmask16 isr = _mm512_cmpeq_epi32_mask(r, mx);
+	__mmask16 isg = (__mmask16)(~isr & _mm512_cmpeq_epi32_mask(g, mx));
+	__mmask16 grey = _mm512_cmpeq_epi32_mask(d, _mm512_setzero_si512());
+	__m512i num = _mm512_sub_epi32(r, g);
+	__m512 off = _mm512_set1_ps(240);
+	__m512 fd = _mm512_cvtepi32_ps(d);
+	__m512 fh, fs;
+
+	num = _mm512_mask_blend_epi32(isg, num, _mm512_sub_epi32(b, r));
+	num = _mm512_mask_blend_epi32(isr, num, _mm512_sub_epi32(g, b));
+	off = _mm512_mask_blend_ps(isg, off, _mm512_set1_ps(120));
+	off = _mm512_mask_blend_ps(isr, off, _mm512_maskz_mov_ps(_mm512_cmpgt_epi32_mask(b, g), _mm512_set1_ps(360)));
+
+	fh = _mm512_div_ps(_mm512_cvtepi32_ps(_mm512_mullo_epi32(num, _mm512_set1_epi32(60))), fd);
+	fh = _mm512_add_ps(off, fh);
+	fh = _mm512_mul_ps(_mm512_div_ps(fh, _mm512_set1_ps(360)), _mm512_set1_ps(255));
+	fs = _mm512_mul_ps(_mm512_div_ps(fd, _mm512_cvtepi32_ps(mx)), _mm512_set1_ps(255));
+
+	*h = _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32((__mmask16)~grey, _mm512_cvttps_epi32(fh)));
+	*s = _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32((__mmask16)~grey, _mm512_cvttps_epi32(fs)));
+}
+
+VC_TARGET("avx512f")
+static int vc_hsv_row_avx512(const unsigned char* src, int n, int bgr, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x, k;
+
+	// 64 pixels per iteration
+	for (x = 0; x + 64 <= n; x += 64) {
+		for (k = 0; k < 4; k++, src += 48, dst += 48) {
+			vc_deinterleave16(src, &c0, &c1, &c2);
+			if (bgr) vc_hsv16_avx512(c2, c1, c0, &h, &s);
+			else vc_hsv16_avx512(c0, c1, c2, &h, &s);
+			vc_interleave16(dst, h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2));
+		}
+	}
+	return x;
+}
+
+VC_TARGET("avx512f")
+static int vc_mask_row_avx512(const unsigned char* src, int n, int bgr, const unsigned char* lo, const unsigned char* hi, int nranges, unsigned char* dst) {
+	__m128i c0, c1, c2, h, s;
+	int x, k;
+
+	for (x = 0; x + 64 <= n; x += 64) {
+		for (k = 0; k < 4; k++, src += 48) {
+			vc_deinterleave16(src, &c0, &c1, &c2);
+			if (bgr) vc_hsv16_avx512(c2, c1, c0, &h, &s);
+			else vc_hsv16_avx512(c0, c1, c2, &h, &s);
+			_mm_storeu_si128((__m128i*)(dst + x + 16 * k), vc_ranges16(h, s, _mm_max_epu8(_mm_max_epu8(c0, c1), c2), lo, hi, nranges));
+		}
+	}
+	return x;
+}
+
+#pragma endregion
+
+#endif
+
+/// <summary>
+/// Converts the first pixels of a row of n RGB (bgr = 0) or BGR (bgr = 1)
+/// pixels to HSV with the selected instruction set. The output is always H, S,
+/// V and identical to vc_pixel_rgb_to_hsv.
+/// </summary>
+/// <returns>Number of pixels converted (a multiple of the block size); the caller converts the rest</returns>
+int vc_simd_hsv_row(const unsigned char* src, int n, int bgr, unsigned char* dst) {
+#ifdef VC_SIMD_X86
+	switch (vc_simd_level()) {
+	case VC_SIMD_AVX512: return vc_hsv_row_avx512(src, n, bgr, dst);
+	case VC_SIMD_AVX2: return vc_hsv_row_avx2(src, n, bgr, dst);
+	case VC_SIMD_SSE41: return vc_hsv_row_sse41(src, n, bgr, dst);
+	}
+#endif
+	return 0;
+}
+
+/// <summary>
+/// Segments the first pixels of a row against byte ranges of H, S and V: dst is
+/// 255 where lo[3k + c] <= channel c <= hi[3k + c] for some range k, 0 elsewhere.
+/// </summary>
+/// <returns>Number of pixels written (a multiple of the block size); the caller does the rest</returns>
+int vc_simd_mask_row(const unsigned char* src, int n, int bgr, const unsigned char* lo, const unsigned char* hi, int nranges, unsigned char* dst) {
+#ifdef VC_SIMD_X86
+	switch (vc_simd_level()) {
+	case VC_SIMD_AVX512: return vc_mask_row_avx512(src, n, bgr, lo, hi, nranges, dst);
+	case VC_SIMD_AVX2: return vc_mask_row_avx2(src, n, bgr, lo, hi, nranges, dst);
+	case VC_SIMD_SSE41: return vc_mask_row_sse41(src, n, bgr, lo, hi, nranges, dst);
+	}
+#endif
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*****************************************************************//**
+ * \file   contour.c
+ * \brief  Outer contours of labelled blobs as Freeman chain codes:
+ *         boundary tracing, measured perimeter and outline drawing.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+// Step of every chain code (y points down, so code 2 goes up)
+static const int chain_dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int chain_dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+// Length of the contour of a straight line at any angle per unit of
+// (steps + sqrt(2) * diagonal steps): pi * (1 + sqrt(2)) / 8 (Kulpa)
+#define VC_CHAIN_SCALE 0.948f
+#define VC_SQRT2 1.41421356f
+// The contour runs through the centres of the boundary pixels, on average
+// 0.44 pixels inside the edge of the blob; the edge of a convex blob is
+// longer by 2 * pi * 0.44 (fitted on digital discs of radius 20 to 100)
+#define VC_CHAIN_OFFSET 2.75f
+
+static int contour_at(LVC* src, int label, int x, int y) {
+	if ((x < 0) || (y < 0) || (x >= src->width) || (y >= src->height)) return 0;
+	return src->data[(size_t)y * src->width + x] == label;
+}
+
+/// <summary>
+/// Moore neighbour tracing of the outer contour of a blob, starting at its
+/// first pixel in raster order (topmost, then leftmost). The neighbours of
+/// each boundary pixel are swept counter-clockwise from the pixel it was
+/// reached from; the trace stops when the start pixel is left again in the
+/// first direction (Jacob's criterion), so thin parts are walked both ways.
+/// The time is proportional to the length of the contour.
+/// </summary>
+/// <param name="src">Label image</param>
+/// <param name="label">Label of the blob</param>
+/// <param name="x">Column of the first pixel of the blob</param>
+/// <param name="y">Row of the first pixel of the blob</param>
+/// <param name="codes">Receives up to capacity chain codes (may be NULL if capacity is 0)</param>
+/// <param name="capacity">Size of codes</param>
+/// <returns>Length of the contour (0 for a single pixel), may be more than capacity</returns>
+int vc_trace_contour(LVC* src, int label, int x, int y, unsigned char* codes, int capacity) {
+	int px = x, py = y, d = 0, first = -1, length = 0, k, s = 0;
+
+	if (!contour_at(src, label, x, y)) return 0;
+
+	while (1) {
+		// The pixel before the start is its west neighbour (background)
+		for (k = 0; k < 8; k++) {
+			s = (d + 5 + k) & 7;
+			if (contour_at(src, label, px + chain_dx[s], py + chain_dy[s])) break;
+		}
+		if (k == 8) return 0;
+
+		if ((px == x) && (py == y)) {
+			if (first < 0) first = s;
+			else if (s == first) return length;
+		}
+		if (length < capacity) codes[length] = (unsigned char)s;
+		length++;
+		px += chain_dx[s];
+		py += chain_dy[s];
+		d = s;
+	}
+}
+
+/// <summary>
+/// Traces the outer contour of every blob and replaces the estimated
+/// perimeter of the blob with the length of its contour. The chain codes of
+/// all blobs are allocated in the arena.
+/// </summary>
+/// <param name="src">Label image</param>
+/// <param name="blobs">Blobs, with their bounding box; blobs[i].label is their label in src</param>
+/// <param name="nlabels">Number of blobs</param>
+/// <param name="contours">Receives the contour of every blob</param>
+/// <param name="arena">Per-frame arena for the chain codes</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_label_contours(LVC* src, OVC* blobs, int nlabels, CVC* contours, VCARENA* arena) {
+	int i, x, capacity, length;
+
+	if ((src == NULL) || (arena == NULL) || ((nlabels > 0) && ((blobs == NULL) || (contours == NULL)))) return 0;
+
+	for (i = 0; i < nlabels; i++) {
+		CVC* contour = &contours[i];
+		int* row = src->data + (size_t)blobs[i].y * src->width;
+
+		// First pixel in raster order: on the top row of the bounding box
+		for (x = blobs[i].x; (x <= blobs[i].xf) && (row[x] != blobs[i].label); x++);
+		contour->x = x;
+		contour->y = blobs[i].y;
+		contour->length = 0;
+		contour->codes = NULL;
+		if (x > blobs[i].xf) continue;
+
+		// Enough for a convex blob; longer contours are traced again
+		capacity = 2 * (blobs[i].width + blobs[i].height) + 4;
+		contour->codes = (unsigned char*)vc_arena_alloc(arena, capacity, 1);
+		if (contour->codes == NULL) return 0;
+		length = vc_trace_contour(src, blobs[i].label, contour->x, contour->y, contour->codes, capacity);
+		if (length > capacity) {
+			contour->codes = (unsigned char*)vc_arena_alloc(arena, length, 1);
+			if (contour->codes == NULL) return 0;
+			vc_trace_contour(src, blobs[i].label, contour->x, contour->y, contour->codes, length);
+		}
+		contour->length = length;
+		blobs[i].perimeter = (int)(vc_contour_perimeter(contour) + 0.5f);
+	}
+	return 1;
+}
+
+/// <summary>
+/// Length of the edge of a blob from its contour: straight steps count 1,
+/// diagonal steps sqrt(2), the sum is scaled so that digital straight edges
+/// are not overestimated whatever their orientation, and the half pixel
+/// between the contour and the edge is added. On digital discs of radius 20
+/// to 100 the result is within 2.5 pixels of 2 * pi * r (1.5 for 98% of radii).
+/// </summary>
+float vc_contour_perimeter(const CVC* contour) {
+	int i, diagonal = 0;
+
+	for (i = 0; i < contour->length; i++) diagonal += contour->codes[i] & 1;
+	return VC_CHAIN_SCALE * ((contour->length - diagonal) + VC_SQRT2 * diagonal) + VC_CHAIN_OFFSET;
+}
+
+/// <summary>
+/// Draws the pixels of every contour in green on a color image.
+/// </summary>
+/// <param name="dst">Color image (contours in its coordinates)</param>
+/// <param name="contours">Contours to draw</param>
+/// <param name="ncontours">Number of contours</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_draw_contours(IVC* dst, const CVC* contours, int ncontours) {
+	int i, k, x, y;
+	long pos;
+
+	if ((dst->data == NULL) || (dst->channels < 3)) return 0;
+
+	for (i = 0; i < ncontours; i++) {
+		x = contours[i].x;
+		y = contours[i].y;
+		for (k = 0; k <= contours[i].length; k++) {
+			if ((x >= 0) && (y >= 0) && (x < dst->width) && (y < dst->height)) {
+				pos = (long)y * dst->bytesperline + x * dst->channels;
+				dst->data[pos] = 0;
+				dst->data[pos + 1] = 255;
+				dst->data[pos + 2] = 0;
+			}
+			if (k < contours[i].length) {
+				x += chain_dx[contours[i].codes[k]];
+				y += chain_dy[contours[i].codes[k]];
+			}
+		}
+	}
+	return 1;
+}
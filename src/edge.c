@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include "vc.h"
 
@@ -92,4 +93,51 @@ int vc_draw_edge(IVC* src, IVC* dst) {
 	return 1;
 }
 
+/// <summary>
+/// Draws the Prewitt edges of a binary mask on a color image, only around the
+/// given blobs: the bounding box of each blob plus margin pixels. Gives the same
+/// pixels as vc_gray_edge_prewitt followed by vc_draw_edge inside those boxes,
+/// without the divisions and the square root: the rounded magnitude is nonzero
+/// exactly when |Gx| or |Gy| (before the division by 6) is at least 6.
+/// </summary>
+/// <param name="src">Binary mask (1 channel)</param>
+/// <param name="dst">Color image of the same size, edges are drawn in green</param>
+/// <param name="blobs">Blobs whose edges are drawn</param>
+/// <param name="nlabels">Number of blobs</param>
+/// <param name="margin">Pixels around each bounding box (1 covers every edge of the blob)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_draw_blob_edges(IVC* src, IVC* dst, OVC* blobs, int nlabels, int margin) {
+	int bytesperline = src->bytesperline;
+	int bpl = dst->bytesperline;
+	int channels = dst->channels;
+	int i, x, y, gx, gy;
+
+	if ((src->data == NULL) || (src->channels != 1) || (channels < 3)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+
+	for (i = 0; i < nlabels; i++) {
+		// The operator leaves the first and last row and column alone
+		int x0 = blobs[i].x - margin < 1 ? 1 : blobs[i].x - margin;
+		int y0 = blobs[i].y - margin < 1 ? 1 : blobs[i].y - margin;
+		int x1 = blobs[i].x + blobs[i].width - 1 + margin > src->width - 2 ? src->width - 2 : blobs[i].x + blobs[i].width - 1 + margin;
+		int y1 = blobs[i].y + blobs[i].height - 1 + margin > src->height - 2 ? src->height - 2 : blobs[i].y + blobs[i].height - 1 + margin;
 
+		for (y = y0; y <= y1; y++) {
+			unsigned char* above = src->data + (long)(y - 1) * bytesperline;
+			unsigned char* row = src->data + (long)y * bytesperline;
+			unsigned char* below = src->data + (long)(y + 1) * bytesperline;
+			unsigned char* pd = dst->data + (long)y * bpl;
+
+			for (x = x0; x <= x1; x++) {
+				gx = (above[x + 1] + row[x + 1] + below[x + 1]) - (above[x - 1] + row[x - 1] + below[x - 1]);
+				gy = (below[x - 1] + below[x] + below[x + 1]) - (above[x - 1] + above[x] + above[x + 1]);
+				if ((abs(gx) >= 6) || (abs(gy) >= 6)) {
+					pd[x * channels] = 0;
+					pd[x * channels + 1] = 255;
+					pd[x * channels + 2] = 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
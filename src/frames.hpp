@@ -0,0 +1,103 @@
+/*****************************************************************//**
+ * \file   frames.hpp
+ * \brief  Input frames of vc_bench and vc_check: synthetic belts with
+ *         coins, random pixels and recorded frames (PPM) tiled to any size.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include "vc.h"
+
+// HSV ranges of the coin mask (same as the detector)
+const HSVRANGE COIN_COLORS[] = {
+	{ 40, 60, 20, 80, 15, 55 },
+	{ 19, 38, 37, 82, 13, 47 },
+	{ 40, 200, 4, 24, 15, 50 },
+};
+const int NCOIN_COLORS = (int)(sizeof(COIN_COLORS) / sizeof(COIN_COLORS[0]));
+
+// Deterministic noise
+inline unsigned int frame_random(unsigned int& state) {
+	state = state * 1664525u + 1013904223u;
+	return state >> 24;
+}
+
+/// <summary>
+/// Synthetic frame: a light belt with copper and gold coins on a grid, both
+/// colours inside the coin ranges, plus some noise.
+/// </summary>
+inline IVC* synthetic_frame(int width, int height) {
+	IVC* image = vc_image_new(width, height, 3, 255);
+	if (image == NULL) return NULL;
+	const unsigned char belt[3] = { 200, 200, 200 };
+	const unsigned char coins[2][3] = { { 36, 58, 89 }, { 45, 82, 89 } };
+	int r = std::max(1, height / 8);
+	int spacing = 3 * r;
+	unsigned int state = 12345;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const unsigned char* color = belt;
+			int gx = x / spacing, gy = y / spacing;
+			int dx = x - (gx * spacing + spacing / 2), dy = y - (gy * spacing + spacing / 2);
+			if (((gx + 1) * spacing <= width) && ((gy + 1) * spacing <= height) && (dx * dx + dy * dy <= r * r)) color = coins[(gx + gy) & 1];
+			unsigned char* p = image->data + (long)y * image->bytesperline + x * 3;
+			for (int c = 0; c < 3; c++) {
+				int v = color[c] + (int)(frame_random(state) % 9) - 4;
+				p[c] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+			}
+		}
+	}
+	return image;
+}
+
+// Frame of random pixels: every hue, saturation and value, grey and saturated ones included
+inline IVC* noise_frame(int width, int height, unsigned int seed) {
+	IVC* image = vc_image_new(width, height, 3, 255);
+	if (image == NULL) return NULL;
+	unsigned int state = seed;
+
+	for (int y = 0; y < height; y++) {
+		unsigned char* p = image->data + (long)y * image->bytesperline;
+		for (int x = 0; x < width; x++, p += 3) {
+			p[0] = (unsigned char)frame_random(state);
+			// One pixel in eight is grey, one in eight has a channel at 0 or 255
+			switch (frame_random(state) & 7) {
+			case 0: p[1] = p[2] = p[0]; break;
+			case 1: p[1] = (unsigned char)frame_random(state); p[2] = (frame_random(state) & 1) ? 255 : 0; break;
+			default: p[1] = (unsigned char)frame_random(state); p[2] = (unsigned char)frame_random(state);
+			}
+		}
+	}
+	return image;
+}
+
+// Recorded frame tiled over width x height
+inline IVC* tiled_frame(IVC* frame, int width, int height) {
+	IVC* image = vc_image_new(width, height, 3, 255);
+	if (image == NULL) return NULL;
+	for (int y = 0; y < height; y++) {
+		const unsigned char* src = frame->data + (long)(y % frame->height) * frame->bytesperline;
+		unsigned char* dst = image->data + (long)y * image->bytesperline;
+		for (int x = 0; x < width; x += frame->width) {
+			int n = std::min(frame->width, width - x);
+			memcpy(dst + x * 3, src, (size_t)n * 3);
+		}
+	}
+	return image;
+}
+
+// Recorded frame: PPM files are RGB, the kernels expect BGR like the video frames.
+// NULL if the file is not a colour PPM.
+inline IVC* read_frame(const char* file) {
+	IVC* frame = vc_read_image((char*)file);
+	if (frame == NULL) return NULL;
+	if (frame->channels != 3) return vc_image_free(frame);
+	vc_gbr_rgb(frame);
+	return frame;
+}
@@ -14,8 +14,19 @@
 #include <ctype.h>
 #include <string.h>
 #include <malloc.h>
+#include <limits.h>
 #include "vc.h"
 
+// The boundary pixels of a disc of radius r form an 8-connected ring of about
+// 4 * sqrt(2) * r pixels, whose centres lie inside the edge of the blob
+// (scale pi / (2 * sqrt(2)), offset fitted on digital discs of radius 20 to 100)
+#define VC_BOUNDARY_SCALE 1.1107f
+#define VC_BOUNDARY_OFFSET 2.2f
+
+// Perimeter of a blob from its number of boundary pixels
+static int vc_boundary_perimeter(int boundary) {
+	return (int)(VC_BOUNDARY_SCALE * boundary + VC_BOUNDARY_OFFSET + 0.5f);
+}
 
 /// <summary>
 /// Performs binary blob labeling on a single‐channel (binary) image.
@@ -35,6 +46,15 @@
 /// Pointer to an array of OVC structs (one per blob) on success, or NULL on error.
 /// </returns>
 OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
+{
+	return vc_binary_blob_labelling_arena(src, dst, nlabels, NULL);
+}
+
+/// <summary>
+/// Same as vc_binary_blob_labelling, but the blob array is allocated from arena
+/// (released by vc_arena_reset). With a NULL arena it is allocated with calloc.
+/// </summary>
+OVC* vc_binary_blob_labelling_arena(IVC* src, IVC* dst, int* nlabels, VCARENA* arena)
 {
 	unsigned char* datasrc = (unsigned char*)src->data;
 	unsigned char* datadst = (unsigned char*)dst->data;
@@ -219,7 +239,7 @@ OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
 	if (*nlabels == 0) return NULL;
 
 	// Cria lista de blobs (objectos) e preenche a etiqueta
-	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
+	blobs = (OVC*)vc_alloc(arena, (*nlabels), sizeof(OVC));
 	if (blobs != NULL)
 	{
 		for (a = 0; a < (*nlabels); a++) blobs[a].label = labeltable[a];
@@ -296,6 +316,469 @@ int vc_binary_blob_info(IVC* src, OVC* blobs, int nlabels) {
 	return 1;
 }
 
+LVC* vc_labels_new(int width, int height) {
+	LVC* labels = (LVC*)malloc(sizeof(LVC));
+
+	if (labels == NULL) return NULL;
+	labels->width = width;
+	labels->height = height;
+	labels->data = (int*)malloc((size_t)width * height * sizeof(int));
+	if (labels->data == NULL) {
+		free(labels);
+		return NULL;
+	}
+	return labels;
+}
+
+LVC* vc_labels_free(LVC* labels) {
+	if (labels != NULL) {
+		free(labels->data);
+		free(labels);
+	}
+	return NULL;
+}
+
+// Root of label a, halving the path on the way
+static int uf_find(int* parent, int a) {
+	while (parent[a] != a) {
+		parent[a] = parent[parent[a]];
+		a = parent[a];
+	}
+	return a;
+}
+
+// Joins the sets of a and b; the smaller label becomes the root
+static int uf_union(int* parent, int a, int b) {
+	a = uf_find(parent, a);
+	b = uf_find(parent, b);
+	if (a < b) {
+		parent[b] = a;
+		return a;
+	}
+	parent[a] = b;
+	return b;
+}
+
+/// <summary>
+/// Union-find labelling of a binary image (src) or of a packed mask (bits); the
+/// other one is NULL. Packed rows are read a word at a time, and words with no
+/// pixel set are 64 background labels.
+/// </summary>
+static OVC* blob_labelling_uf(IVC* src, BVC* bits, LVC* dst, int* nlabels, VCARENA* arena)
+{
+	int width = src != NULL ? src->width : bits->width;
+	int height = src != NULL ? src->height : bits->height;
+	int* lab = dst->data;
+	int* parent;
+	int label = 1;
+	int x, y, a, n, x0, x1;
+	size_t maxlabels;
+	OVC* blobs;
+
+	*nlabels = 0;
+	if ((width <= 0) || (height <= 0) || (width != dst->width) || (height != dst->height)) return NULL;
+	if ((src != NULL) && ((src->data == NULL) || (src->channels != 1))) return NULL;
+
+	// A new label needs a background pixel before it on the row and above it,
+	// so there are at most one per 2x2 cell. Entries are set when their label
+	// is created, so the table is not cleared.
+	maxlabels = (size_t)((width + 1) / 2) * ((height + 1) / 2) + 2;
+	parent = (int*)vc_alloc_raw(arena, maxlabels, sizeof(int));
+	if (parent == NULL) return NULL;
+
+	// First and last rows are background
+	memset(lab, 0, (size_t)width * sizeof(int));
+	memset(lab + (size_t)(height - 1) * width, 0, (size_t)width * sizeof(int));
+
+	for (y = 1; y < height - 1; y++)
+	{
+		unsigned char* ps = src != NULL ? src->data + y * src->bytesperline : NULL;
+		uint64_t* pb = bits != NULL ? bits->data + (size_t)y * bits->words : NULL;
+		int* pl = lab + (size_t)y * width;
+		int* pu = pl - width;
+
+		pl[0] = 0;
+		pl[width - 1] = 0;
+		for (x0 = 0; x0 < width; x0 += 64)
+		{
+			uint64_t word = pb != NULL ? pb[x0 / 64] : 0;
+			x = x0 > 1 ? x0 : 1;
+			x1 = x0 + 64 < width - 1 ? x0 + 64 : width - 1;
+			if ((pb != NULL) && (word == 0)) {
+				if (x < x1) memset(pl + x, 0, (size_t)(x1 - x) * sizeof(int));
+				continue;
+			}
+
+			for (; x < x1; x++)
+			{
+				// Kernel:
+				// A B C
+				// D X
+				if (pb != NULL ? ((word >> (x & 63)) & 1) == 0 : ps[x] == 0) {
+					pl[x] = 0;
+					continue;
+				}
+
+				n = 0;
+				if (pu[x - 1] != 0) n = pu[x - 1];
+				if (pu[x] != 0) n = n ? uf_union(parent, n, pu[x]) : pu[x];
+				if (pu[x + 1] != 0) n = n ? uf_union(parent, n, pu[x + 1]) : pu[x + 1];
+				if (pl[x - 1] != 0) n = n ? uf_union(parent, n, pl[x - 1]) : pl[x - 1];
+
+				if (n == 0) {
+					parent[label] = label;
+					n = label++;
+				}
+				pl[x] = n;
+			}
+		}
+	}
+
+	// Final labels: roots numbered 1..nlabels in order of appearance.
+	// parent[a] <= a, so the entry it points to already holds its final label.
+	parent[0] = 0;
+	for (a = 1; a < label; a++)
+	{
+		if (parent[a] == a) parent[a] = ++(*nlabels);
+		else parent[a] = parent[parent[a]];
+	}
+
+	for (y = 1; y < height - 1; y++)
+	{
+		int* pl = lab + (size_t)y * width;
+		for (x = 1; x < width - 1; x++) pl[x] = parent[pl[x]];
+	}
+	vc_release(arena, parent);
+
+	if (*nlabels == 0) return NULL;
+
+	blobs = (OVC*)vc_alloc(arena, *nlabels, sizeof(OVC));
+	if (blobs == NULL) {
+		*nlabels = 0;
+		return NULL;
+	}
+	for (a = 0; a < *nlabels; a++) blobs[a].label = a + 1;
+
+	return blobs;
+}
+
+/// <summary>
+/// Binary blob labelling with union-find (path halving) and 32-bit labels.
+/// Finds the same blobs as vc_binary_blob_labelling (8-connectivity, the image
+/// border is background, blobs numbered in order of appearance) without its
+/// 254 label limit and with near-constant cost per equivalence.
+/// </summary>
+/// <param name="src">Source binary image (1 channel, 0 = background).</param>
+/// <param name="dst">Label image of the same size as src.</param>
+/// <param name="nlabels">On return, the number of blobs.</param>
+/// <param name="arena">Arena for the equivalence table and the blobs (NULL for malloc).</param>
+/// <returns>Array of nlabels OVC (label filled in), or NULL if there are no blobs or on error.</returns>
+OVC* vc_binary_blob_labelling_uf(IVC* src, LVC* dst, int* nlabels, VCARENA* arena)
+{
+	return blob_labelling_uf(src, NULL, dst, nlabels, arena);
+}
+
+/// <summary>
+/// Same labels and blobs as vc_binary_blob_labelling_uf, read from a packed mask.
+/// </summary>
+/// <param name="src">Packed mask.</param>
+/// <param name="dst">Label image of the same size as src.</param>
+/// <param name="nlabels">On return, the number of blobs.</param>
+/// <param name="arena">Arena for the equivalence table and the blobs (NULL for malloc).</param>
+/// <returns>Array of nlabels OVC (label filled in), or NULL if there are no blobs or on error.</returns>
+OVC* vc_bits_blob_labelling_uf(BVC* src, LVC* dst, int* nlabels, VCARENA* arena)
+{
+	return blob_labelling_uf(NULL, src, dst, nlabels, arena);
+}
+
+/// <summary>
+/// Same results as vc_binary_blob_info, for a 32-bit label image, in one pass:
+/// the statistics of every blob are accumulated in the slot of its label.
+/// Also counts the boundary pixels of each blob (pixels with a 4-neighbour
+/// outside the blob) into blobs[i].boundary, and measures the perimeter from
+/// them: within 2.5 pixels of 2 * pi * r on digital discs.
+/// </summary>
+/// <param name="src">Label image (labels 1..nlabels)</param>
+/// <param name="blobs">Array of nlabels OVC, blobs[i].label = i + 1</param>
+/// <param name="nlabels">Number of blobs</param>
+/// <param name="arena">Arena for the centroid sums (NULL for calloc/free)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_label_blob_info(LVC* src, OVC* blobs, int nlabels, VCARENA* arena) {
+	int width = src->width;
+	int height = src->height;
+	long long* sums;
+	int x, y, i, l;
+
+	if ((blobs == NULL) || (nlabels <= 0)) return 0;
+
+	sums = (long long*)vc_alloc(arena, 2 * (size_t)(nlabels + 1), sizeof(long long));
+	if (sums == NULL) return 0;
+
+	for (i = 0; i < nlabels; i++) {
+		blobs[i].x = width - 1;
+		blobs[i].y = height - 1;
+		blobs[i].xf = 0;
+		blobs[i].yf = 0;
+		blobs[i].area = 0;
+		blobs[i].boundary = 0;
+	}
+
+	for (y = 0; y < height; y++) {
+		int* pl = src->data + (size_t)y * width;
+		for (x = 0; x < width; x++) {
+			l = pl[x];
+			if (l == 0) continue;
+
+			OVC* b = &blobs[l - 1];
+			sums[2 * l] += x;
+			sums[2 * l + 1] += y;
+			b->area++;
+			if (b->x > x) b->x = x;
+			if (b->y > y) b->y = y;
+			if (b->xf < x) b->xf = x;
+			if (b->yf < y) b->yf = y;
+
+			// Pixels on the image border are always on the boundary
+			if ((x == 0) || (y == 0) || (x == width - 1) || (y == height - 1) ||
+				(pl[x - 1] != l) || (pl[x + 1] != l) || (pl[x - width] != l) || (pl[x + width] != l)) {
+				b->boundary++;
+			}
+		}
+	}
+
+	for (i = 0; i < nlabels; i++) {
+		l = i + 1;
+		//Perimeter
+		blobs[i].perimeter = vc_boundary_perimeter(blobs[i].boundary);
+
+		//Centro de gravidade
+		if (blobs[i].area != 0) {
+			blobs[i].xc = (int)(sums[2 * l] / blobs[i].area);
+			blobs[i].yc = (int)(sums[2 * l + 1] / blobs[i].area);
+		}
+		blobs[i].width = (blobs[i].xf - blobs[i].x) + 1;
+		blobs[i].height = (blobs[i].yf - blobs[i].y) + 1;
+	}
+
+	vc_release(arena, sums);
+	return 1;
+}
+
+/// <summary>
+/// Same filter as vc_check_if_circle, but the rejected blobs are not erased from
+/// the image: remap[label] receives the new label of every blob (0 when
+/// rejected), to be applied to the label image with vc_labels_remap only when
+/// the pixels are needed. The accepted blobs are compacted at the start of
+/// blobs and renumbered 1..nLabels.
+/// </summary>
+/// <param name="blobs">Array of blobs (labels 1..nLabels)</param>
+/// <param name="nLabels">Number of blobs, on return the number accepted</param>
+/// <param name="remap">Array of at least nLabels + 1 ints</param>
+/// <returns>blobs, or NULL if no blob was accepted</returns>
+OVC* vc_check_if_circle_remap(OVC* blobs, int* nLabels, int* remap) {
+	float areaBoundingBox;
+	float value;
+	int validCount = 0;
+
+	remap[0] = 0;
+	for (int i = 0; i < *nLabels; i++) {
+		areaBoundingBox = (float)blobs[i].width * (float)blobs[i].height;
+		value = areaBoundingBox / (float)blobs[i].area;
+
+		if (value > 1.2f && value < 1.351f && blobs[i].area > 1400) {
+			blobs[validCount] = blobs[i];
+			blobs[validCount].label = validCount + 1;
+			remap[blobs[i].label] = ++validCount;
+		}
+		else remap[blobs[i].label] = 0;
+	}
+
+	*nLabels = validCount;
+	return validCount > 0 ? blobs : NULL;
+}
+
+/// <summary>
+/// Applies a remap table to a label image and writes the binary mask of the
+/// remaining blobs (255) to dst.
+/// </summary>
+/// <param name="src">Label image, relabelled in place</param>
+/// <param name="remap">New label for every old label (0 = background)</param>
+/// <param name="dst">Binary image of the same size (NULL to only relabel)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_labels_remap(LVC* src, const int* remap, IVC* dst) {
+	int x, y;
+
+	if ((dst != NULL) && ((dst->width != src->width) || (dst->height != src->height) || (dst->channels != 1))) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		int* pl = src->data + (size_t)y * src->width;
+		unsigned char* pd = dst != NULL ? dst->data + y * dst->bytesperline : NULL;
+		for (x = 0; x < src->width; x++) {
+			pl[x] = remap[pl[x]];
+			if (pd != NULL) pd[x] = pl[x] ? 255 : 0;
+		}
+	}
+	return 1;
+}
+
+// Part of a run that is labelled: the image border is background, as in vc_binary_blob_labelling
+static int rle_clip(RVC* rle, int y, VCRUN* run, int* x0, int* x1) {
+	if ((y == 0) || (y == rle->height - 1)) return 0;
+	*x0 = run->x0 < 1 ? 1 : run->x0;
+	*x1 = run->x1 > rle->width - 1 ? rle->width - 1 : run->x1;
+	return *x0 < *x1;
+}
+
+/// <summary>
+/// Blob labelling on runs: a run joins every run of the previous row that it
+/// touches (8-connectivity), with union-find on the run labels. Finds the same
+/// blobs, in the same order, as vc_binary_blob_labelling_uf. The label of each
+/// run is stored in run.label; pixels on the image border are background, so
+/// they are cut from the runs (runs only on the border keep label 0).
+/// </summary>
+/// <param name="src">Run-length encoded binary image.</param>
+/// <param name="nlabels">On return, the number of blobs.</param>
+/// <param name="arena">Arena for the equivalence table and the blobs (NULL for malloc).</param>
+/// <returns>Array of nlabels OVC (label filled in), or NULL if there are no blobs or on error.</returns>
+OVC* vc_rle_blob_labelling(RVC* src, int* nlabels, VCARENA* arena) {
+	int* parent;
+	int label = 1;
+	int y, i, j, a, x0, x1, px0, px1;
+	OVC* blobs;
+
+	*nlabels = 0;
+	parent = (int*)vc_alloc(arena, (size_t)src->nruns + 1, sizeof(int));
+	if (parent == NULL) return NULL;
+
+	for (y = 0; y < src->height; y++) {
+		// First run of the previous row that can still touch the current runs
+		j = y > 0 ? src->row[y - 1] : 0;
+		for (i = src->row[y]; i < src->row[y + 1]; i++) {
+			VCRUN* run = &src->runs[i];
+			run->label = 0;
+			if (!rle_clip(src, y, run, &x0, &x1)) continue;
+			run->x0 = x0;
+			run->x1 = x1;
+
+			while ((j < src->row[y]) && (src->runs[j].x1 < x0)) j++;
+			for (a = j; (a < src->row[y]) && (src->runs[a].x0 <= x1); a++) {
+				VCRUN* up = &src->runs[a];
+				if ((up->label == 0) || !rle_clip(src, y - 1, up, &px0, &px1)) continue;
+				if ((px1 < x0) || (px0 > x1)) continue;
+				run->label = run->label ? uf_union(parent, run->label, up->label) : up->label;
+			}
+			if (run->label == 0) {
+				parent[label] = label;
+				run->label = label++;
+			}
+		}
+	}
+
+	// Final labels, as in vc_binary_blob_labelling_uf
+	parent[0] = 0;
+	for (a = 1; a < label; a++) {
+		if (parent[a] == a) parent[a] = ++(*nlabels);
+		else parent[a] = parent[parent[a]];
+	}
+	for (i = 0; i < src->nruns; i++) src->runs[i].label = parent[src->runs[i].label];
+	vc_release(arena, parent);
+
+	if (*nlabels == 0) return NULL;
+
+	blobs = (OVC*)vc_alloc(arena, *nlabels, sizeof(OVC));
+	if (blobs == NULL) {
+		*nlabels = 0;
+		return NULL;
+	}
+	for (a = 0; a < *nlabels; a++) blobs[a].label = a + 1;
+
+	return blobs;
+}
+
+/// <summary>
+/// Same results as vc_label_blob_info, computed from the runs labelled by
+/// vc_rle_blob_labelling: area, bounding box and centroid come from run sums,
+/// and a run pixel is on the boundary unless it has runs above and below.
+/// The perimeter is measured from the boundary pixels as in vc_label_blob_info.
+/// </summary>
+/// <param name="src">Labelled run-length encoded image</param>
+/// <param name="blobs">Array of nlabels OVC, blobs[i].label = i + 1</param>
+/// <param name="nlabels">Number of blobs</param>
+/// <param name="arena">Arena for the centroid sums (NULL for calloc/free)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_blob_info(RVC* src, OVC* blobs, int nlabels, VCARENA* arena) {
+	long long* sums;
+	int y, i, a, c, l, ja, jc;
+	int x0, x1, px0, px1, qx0, qx1, s, e, interior;
+
+	if ((blobs == NULL) || (nlabels <= 0)) return 0;
+
+	sums = (long long*)vc_alloc(arena, 2 * (size_t)(nlabels + 1), sizeof(long long));
+	if (sums == NULL) return 0;
+
+	for (i = 0; i < nlabels; i++) {
+		blobs[i].x = src->width - 1;
+		blobs[i].y = src->height - 1;
+		blobs[i].xf = 0;
+		blobs[i].yf = 0;
+		blobs[i].area = 0;
+		blobs[i].boundary = 0;
+	}
+
+	for (y = 1; y < src->height - 1; y++) {
+		ja = src->row[y - 1];
+		jc = src->row[y + 1];
+		for (i = src->row[y]; i < src->row[y + 1]; i++) {
+			VCRUN* run = &src->runs[i];
+			if ((run->label == 0) || !rle_clip(src, y, run, &x0, &x1)) continue;
+
+			l = run->label;
+			OVC* b = &blobs[l - 1];
+			b->area += x1 - x0;
+			sums[2 * l] += (long long)(x1 - x0) * (x0 + x1 - 1) / 2;
+			sums[2 * l + 1] += (long long)(x1 - x0) * y;
+			if (b->x > x0) b->x = x0;
+			if (b->y > y) b->y = y;
+			if (b->xf < x1 - 1) b->xf = x1 - 1;
+			if (b->yf < y) b->yf = y;
+
+			// Interior pixels: not at the ends of the run, with a run above and below
+			interior = 0;
+			while ((ja < src->row[y]) && (src->runs[ja].x1 <= x0 + 1)) ja++;
+			while ((jc < src->row[y + 2]) && (src->runs[jc].x1 <= x0 + 1)) jc++;
+			for (a = ja; (a < src->row[y]) && (src->runs[a].x0 < x1 - 1); a++) {
+				if ((src->runs[a].label == 0) || !rle_clip(src, y - 1, &src->runs[a], &px0, &px1)) continue;
+				if (px0 < x0 + 1) px0 = x0 + 1;
+				if (px1 > x1 - 1) px1 = x1 - 1;
+				for (c = jc; (c < src->row[y + 2]) && (src->runs[c].x0 < px1); c++) {
+					if ((src->runs[c].label == 0) || !rle_clip(src, y + 1, &src->runs[c], &qx0, &qx1)) continue;
+					s = qx0 > px0 ? qx0 : px0;
+					e = qx1 < px1 ? qx1 : px1;
+					if (s < e) interior += e - s;
+				}
+			}
+			b->boundary += (x1 - x0) - interior;
+		}
+	}
+
+	for (i = 0; i < nlabels; i++) {
+		l = i + 1;
+		//Perimeter
+		blobs[i].perimeter = vc_boundary_perimeter(blobs[i].boundary);
+
+		//Centro de gravidade
+		if (blobs[i].area != 0) {
+			blobs[i].xc = (int)(sums[2 * l] / blobs[i].area);
+			blobs[i].yc = (int)(sums[2 * l + 1] / blobs[i].area);
+		}
+		blobs[i].width = (blobs[i].xf - blobs[i].x) + 1;
+		blobs[i].height = (blobs[i].yf - blobs[i].y) + 1;
+	}
+
+	vc_release(arena, sums);
+	return 1;
+}
+
 int check_circle(OVC blob) {
 	int box = blob.width * blob.height;
 	if (blob.area == 0) return 0;
@@ -394,6 +877,14 @@ int vc_draw_bounding_box(IVC* dest, OVC* blobs, int nlabels) {
 /// or NULL if no valid circles remain.
 /// </returns>
 OVC* vc_check_if_circle(OVC* blobs, int* nLabels, IVC* src) { 
+	return vc_check_if_circle_arena(blobs, nLabels, src, NULL);
+}
+
+/// <summary>
+/// Same as vc_check_if_circle, with blobs and the returned array in arena
+/// (NULL for calloc/free).
+/// </summary>
+OVC* vc_check_if_circle_arena(OVC* blobs, int* nLabels, IVC* src, VCARENA* arena) {
 	float areaBoundingBox;
 	float value;
 	int validCount = 0;
@@ -413,11 +904,11 @@ OVC* vc_check_if_circle(OVC* blobs, int* nLabels, IVC* src) {
 
 	if (validCount == 0) {
 		*nLabels = validCount;
-		free(blobs);
+		vc_release(arena, blobs);
 		return NULL;
 	}
 
-	OVC* newBlobs = (OVC*)calloc(validCount, sizeof(OVC));
+	OVC* newBlobs = (OVC*)vc_alloc(arena, validCount, sizeof(OVC));
 	if (newBlobs != NULL) {
 		int j = 0;
 		for (int i = 0; i < *nLabels; i++) {
@@ -428,7 +919,7 @@ OVC* vc_check_if_circle(OVC* blobs, int* nLabels, IVC* src) {
 	}
 
 	*nLabels = validCount; 
-	free(blobs);
+	vc_release(arena, blobs);
 	return newBlobs;
 }
 
@@ -460,34 +951,33 @@ int vc_main_collisions(OVC blob, OVC* secondBlobs, int secondBlob) {
 	return res;
 }
 
-int idCoin(int area, int perimeter) {
-	if (area >= 24500 && area <= 25500 && perimeter > 550 && perimeter < 600) {
-		return 50; //funciona
-	}
-	else if (area >= 20000 && area <= 21500 && perimeter > 500 && perimeter < 550) {
-		return 20; //funciona
-	}
-	else if (area >= 27000 && area <= 28000 && perimeter > 600 && perimeter < 650) {
-		return 200; //funciona
-	}
-	else if (area >= 16000 && area <= 17000 && perimeter > 450 && perimeter <= 500) {
-		return 10;
-	}
-	else if (area >= 17500 && area <= 19000) {
-		return 5;
-	}
-	else if (area >= 21000 && perimeter > 500) {
-		return 100; //funciona
-	}
-	else if (area >= 14000 && area < 15500) {
-		return 2;
-	}
-	else if (area < 12000) {
-		return 1; //funciona
+// Rules of idCoin, tried in order
+const COINRULE vc_coin_rules[VC_NCOINRULES] = {
+	{ 50, 24500, 25500, 551, 599 },
+	{ 20, 20000, 21500, 501, 549 },
+	{ 200, 27000, 28000, 601, 649 },
+	{ 10, 16000, 17000, 451, 500 },
+	{ 5, 17500, 19000, INT_MIN, INT_MAX },
+	{ 100, 21000, INT_MAX, 501, INT_MAX },
+	{ 2, 14000, 15499, INT_MIN, INT_MAX },
+	{ 1, INT_MIN, 11999, INT_MIN, INT_MAX },
+};
+
+/// <summary>
+/// Value of the coin of the first rule whose area and perimeter bounds hold.
+/// </summary>
+/// <returns>Coin value in cents, 0 if no rule matches</returns>
+int vc_coin_classify(const COINRULE* rules, int nrules, int area, int perimeter) {
+	for (int i = 0; i < nrules; i++) {
+		if ((area >= rules[i].amin) && (area <= rules[i].amax) && (perimeter >= rules[i].pmin) && (perimeter <= rules[i].pmax)) return rules[i].coin;
 	}
 	return 0;
 }
 
+int idCoin(int area, int perimeter) {
+	return vc_coin_classify(vc_coin_rules, VC_NCOINRULES, area, perimeter);
+}
+
 int vc_center(OVC* blobs, IVC* dst, int nlabels) {
 	int res = dst->height * dst->width;
 	for (int k = 0; k < nlabels; k++) {
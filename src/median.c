@@ -0,0 +1,201 @@
+/*****************************************************************//**
+ * \file   median.c
+ * \brief  5x5 median filter (same result as cv::medianBlur(src, dst, 5))
+ *         with a sorting network vectorised across the bytes of a row.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VC_MEDIAN_X86
+#include <immintrin.h>
+#endif
+
+// SSE2 is part of the target (every x86-64 build), so no CPU check is needed
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VC_MEDIAN_SSE2
+#endif
+
+#if defined(VC_MEDIAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VC_TARGET(isa)
+#endif
+
+// Bytes read past the end of a padded row by the widest kernel
+#define VC_MEDIAN_SLACK 32
+// Padded rows kept on the stack (5 rows of a 4K colour frame fit)
+#define VC_MEDIAN_MAX_STACK_BYTES (64 * 1024)
+
+// Comparators of a median-of-25 selection network (Devillard): after
+// OP(a, b) = (min, max) on all of them, p[12] is the median
+#define VC_MEDIAN25(OP) \
+	OP(1, 2) OP(0, 1) OP(1, 2) OP(4, 5) OP(3, 4) OP(4, 5) OP(0, 3) OP(2, 5) \
+	OP(2, 3) OP(1, 4) OP(1, 2) OP(3, 4) OP(7, 8) OP(6, 7) OP(7, 8) OP(10, 11) \
+	OP(9, 10) OP(10, 11) OP(6, 9) OP(8, 11) OP(8, 9) OP(7, 10) OP(7, 8) OP(9, 10) \
+	OP(0, 6) OP(4, 10) OP(4, 6) OP(2, 8) OP(2, 4) OP(6, 8) OP(1, 7) OP(5, 11) \
+	OP(5, 7) OP(3, 9) OP(3, 5) OP(7, 9) OP(1, 2) OP(3, 4) OP(5, 6) OP(7, 8) \
+	OP(9, 10) OP(13, 14) OP(12, 13) OP(13, 14) OP(16, 17) OP(15, 16) OP(16, 17) OP(12, 15) \
+	OP(14, 17) OP(14, 15) OP(13, 16) OP(13, 14) OP(15, 16) OP(19, 20) OP(18, 19) OP(19, 20) \
+	OP(21, 22) OP(23, 24) OP(21, 23) OP(22, 24) OP(22, 23) OP(18, 21) OP(20, 23) OP(20, 21) \
+	OP(19, 22) OP(22, 24) OP(19, 20) OP(21, 22) OP(23, 24) OP(12, 18) OP(16, 22) OP(16, 18) \
+	OP(14, 20) OP(20, 24) OP(14, 16) OP(18, 20) OP(22, 24) OP(13, 19) OP(17, 23) OP(17, 19) \
+	OP(15, 21) OP(15, 17) OP(19, 21) OP(13, 14) OP(15, 16) OP(17, 18) OP(19, 20) OP(21, 22) \
+	OP(23, 24) OP(0, 12) OP(8, 20) OP(8, 12) OP(4, 16) OP(16, 24) OP(12, 16) OP(2, 14) \
+	OP(10, 22) OP(10, 14) OP(6, 18) OP(6, 10) OP(10, 12) OP(1, 13) OP(9, 21) OP(9, 13) \
+	OP(5, 17) OP(13, 17) OP(3, 15) OP(11, 23) OP(11, 15) OP(7, 19) OP(7, 11) OP(11, 13) \
+	OP(11, 12)
+
+typedef void (*VCMEDIANROW)(unsigned char* const* rows, int n, int channels, unsigned char* dst);
+
+static void median_row_scalar(unsigned char* const* rows, int n, int channels, unsigned char* dst) {
+	unsigned char p[25], t;
+	int i, j, k;
+
+#define VC_MEDIAN_OP(a, b) t = p[a] < p[b] ? p[a] : p[b]; p[b] ^= p[a] ^ t; p[a] = t;
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < 5; k++) {
+			for (j = 0; j < 5; j++) p[5 * k + j] = rows[k][i + j * channels];
+		}
+		VC_MEDIAN25(VC_MEDIAN_OP)
+		dst[i] = p[12];
+	}
+#undef VC_MEDIAN_OP
+}
+
+#if defined(VC_MEDIAN_X86)
+// 16 bytes (pixels and channels) at a time
+VC_TARGET("sse2")
+static void median_row_sse2(unsigned char* const* rows, int n, int channels, unsigned char* dst) {
+	__m128i p[25], t;
+	unsigned char tail[16];
+	int i, j, k;
+
+#define VC_MEDIAN_OP(a, b) t = _mm_min_epu8(p[a], p[b]); p[b] = _mm_max_epu8(p[a], p[b]); p[a] = t;
+	for (i = 0; i < n; i += 16) {
+		for (k = 0; k < 5; k++) {
+			for (j = 0; j < 5; j++) p[5 * k + j] = _mm_loadu_si128((const __m128i*)(rows[k] + i + j * channels));
+		}
+		VC_MEDIAN25(VC_MEDIAN_OP)
+		if (i + 16 <= n) _mm_storeu_si128((__m128i*)(dst + i), p[12]);
+		else {
+			_mm_storeu_si128((__m128i*)tail, p[12]);
+			memcpy(dst + i, tail, n - i);
+		}
+	}
+#undef VC_MEDIAN_OP
+}
+
+// 32 bytes at a time
+VC_TARGET("avx2")
+static void median_row_avx2(unsigned char* const* rows, int n, int channels, unsigned char* dst) {
+	__m256i p[25], t;
+	unsigned char tail[32];
+	int i, j, k;
+
+#define VC_MEDIAN_OP(a, b) t = _mm256_min_epu8(p[a], p[b]); p[b] = _mm256_max_epu8(p[a], p[b]); p[a] = t;
+	for (i = 0; i < n; i += 32) {
+		for (k = 0; k < 5; k++) {
+			for (j = 0; j < 5; j++) p[5 * k + j] = _mm256_loadu_si256((const __m256i*)(rows[k] + i + j * channels));
+		}
+		VC_MEDIAN25(VC_MEDIAN_OP)
+		if (i + 32 <= n) _mm256_storeu_si256((__m256i*)(dst + i), p[12]);
+		else {
+			_mm256_storeu_si256((__m256i*)tail, p[12]);
+			memcpy(dst + i, tail, n - i);
+		}
+	}
+#undef VC_MEDIAN_OP
+}
+#endif
+
+// Copies row y of src with 2 pixels replicated on each side and zeroed slack
+static void median_pad_row(IVC* src, int y, unsigned char* pad) {
+	int c = src->channels;
+	int n = src->width * c;
+	unsigned char* ps = src->data + (long)y * src->bytesperline;
+
+	memcpy(pad, ps, c);
+	memcpy(pad + c, ps, c);
+	memcpy(pad + 2 * c, ps, n);
+	memcpy(pad + 2 * c + n, ps + n - c, c);
+	memcpy(pad + 3 * c + n, ps + n - c, c);
+	memset(pad + 4 * c + n, 0, VC_MEDIAN_SLACK);
+}
+
+/// <summary>
+/// Rows y0 to y1 - 1 of the 5x5 median of src, written to rows 0 to y1 - y0 - 1
+/// of dst (e.g. a strip buffer, or a view of the same rows of a full image).
+/// Pixels outside src are replicated from its border, as cv::medianBlur does,
+/// so src can be a view of a region of interest. Every channel is filtered on
+/// its own. Uses AVX2 when vc_simd_level() allows it, otherwise SSE2 when the
+/// build targets it, whatever the level (the scalar code is far slower).
+/// </summary>
+/// <param name="src">Source image (any number of channels)</param>
+/// <param name="y0">First row</param>
+/// <param name="y1">Last row + 1</param>
+/// <param name="dst">Destination image, same width and channels as src, at least y1 - y0 rows (not src)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_median5_rows(IVC* src, int y0, int y1, IVC* dst) {
+	unsigned char stack[VC_MEDIAN_MAX_STACK_BYTES];
+	unsigned char* pad;
+	unsigned char* rows[5];
+	int tags[5] = { -1, -1, -1, -1, -1 };
+	VCMEDIANROW kernel = median_row_scalar;
+	int c = src->channels;
+	int len = (src->width + 4) * c + VC_MEDIAN_SLACK;
+	int y, k, sy;
+
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((dst->width != src->width) || (dst->channels != c) || (dst->data == src->data)) return 0;
+	if ((y0 < 0) || (y1 > src->height) || (y0 > y1) || (dst->height < y1 - y0)) return 0;
+
+#if defined(VC_MEDIAN_SSE2)
+	kernel = median_row_sse2;
+#elif defined(VC_MEDIAN_X86)
+	// 32-bit build without SSE2: every CPU with SSE4.1 has it
+	if (vc_simd_level() >= VC_SIMD_SSE41) kernel = median_row_sse2;
+#endif
+#if defined(VC_MEDIAN_X86)
+	if (vc_simd_level() >= VC_SIMD_AVX2) kernel = median_row_avx2;
+#endif
+
+	// Padded copies of the last 5 source rows, slot = row % 5
+	pad = (size_t)5 * len <= VC_MEDIAN_MAX_STACK_BYTES ? stack : (unsigned char*)malloc((size_t)5 * len);
+	if (pad == NULL) return 0;
+
+	for (y = y0; y < y1; y++) {
+		for (k = 0; k < 5; k++) {
+			sy = y - 2 + k;
+			sy = sy < 0 ? 0 : (sy >= src->height ? src->height - 1 : sy);
+			if (tags[sy % 5] != sy) {
+				median_pad_row(src, sy, pad + (sy % 5) * len);
+				tags[sy % 5] = sy;
+			}
+			rows[k] = pad + (sy % 5) * len;
+		}
+		kernel(rows, src->width * c, c, dst->data + (long)(y - y0) * dst->bytesperline);
+	}
+
+	if (pad != stack) free(pad);
+	return 1;
+}
+
+/// <summary>
+/// 5x5 median of the whole image, same result as cv::medianBlur(src, dst, 5).
+/// </summary>
+/// <param name="src">Source image (any number of channels)</param>
+/// <param name="dst">Destination image, same size as src (not src)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_median5(IVC* src, IVC* dst) {
+	if (dst->height != src->height) return 0;
+	return vc_median5_rows(src, 0, src->height, dst);
+}
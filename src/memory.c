@@ -0,0 +1,230 @@
+/*****************************************************************//**
+ * \file   memory.c
+ * \brief  Frame-scoped arena allocator and a pool of reusable images,
+ *         so the per-frame processing does no heap allocations.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+// Size of the block header, keeping the data 16-byte aligned
+#define VC_ARENA_HEADER ((sizeof(VCARENABLOCK) + 15) & ~(size_t)15)
+
+static VCARENABLOCK* vc_arena_block_new(size_t size, VCARENABLOCK* next) {
+	VCARENABLOCK* block = (VCARENABLOCK*)malloc(VC_ARENA_HEADER + size);
+
+	if (block == NULL) return NULL;
+	block->next = next;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+/// <summary>
+/// Creates an arena. Allocations are served from one block; when it runs out a
+/// new block is chained, and the next vc_arena_reset merges them into a single
+/// block big enough for the whole frame, so after the first frames no more
+/// heap allocations happen.
+/// </summary>
+/// <param name="size">Initial size in bytes</param>
+/// <returns>Pointer to the arena, or NULL on error</returns>
+VCARENA* vc_arena_new(size_t size) {
+	VCARENA* arena = (VCARENA*)malloc(sizeof(VCARENA));
+
+	if (arena == NULL) return NULL;
+	if (size < 1024) size = 1024;
+	arena->blocks = vc_arena_block_new(size, NULL);
+	arena->used = 0;
+	arena->peak = 0;
+	if (arena->blocks == NULL) {
+		free(arena);
+		return NULL;
+	}
+	return arena;
+}
+
+VCARENA* vc_arena_free(VCARENA* arena) {
+	VCARENABLOCK* block;
+
+	if (arena != NULL) {
+		while (arena->blocks != NULL) {
+			block = arena->blocks;
+			arena->blocks = block->next;
+			free(block);
+		}
+		free(arena);
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Allocates memory that stays valid until the next vc_arena_reset, without
+/// clearing it: for tables whose entries are written before they are read.
+/// </summary>
+/// <param name="arena">Arena</param>
+/// <param name="n">Number of elements</param>
+/// <param name="size">Size of each element</param>
+/// <returns>Pointer to the memory (16-byte aligned), or NULL on error</returns>
+void* vc_arena_alloc_raw(VCARENA* arena, size_t n, size_t size) {
+	VCARENABLOCK* block = arena->blocks;
+	size_t bytes = (n * size + 15) & ~(size_t)15;
+	unsigned char* p;
+
+	if (bytes == 0) bytes = 16;
+	if (block->used + bytes > block->size) {
+		size_t blocksize = block->size > bytes ? block->size : bytes;
+		block = vc_arena_block_new(blocksize, arena->blocks);
+		if (block == NULL) return NULL;
+		arena->blocks = block;
+	}
+
+	p = (unsigned char*)block + VC_ARENA_HEADER + block->used;
+	block->used += bytes;
+	arena->used += bytes;
+	if (arena->used > arena->peak) arena->peak = arena->used;
+	return p;
+}
+
+/// <summary>
+/// Allocates zeroed memory that stays valid until the next vc_arena_reset.
+/// </summary>
+/// <param name="arena">Arena</param>
+/// <param name="n">Number of elements</param>
+/// <param name="size">Size of each element</param>
+/// <returns>Pointer to the memory (16-byte aligned), or NULL on error</returns>
+void* vc_arena_alloc(VCARENA* arena, size_t n, size_t size) {
+	void* p = vc_arena_alloc_raw(arena, n, size);
+
+	if (p != NULL) memset(p, 0, n * size);
+	return p;
+}
+
+/// <summary>
+/// Releases everything allocated from the arena since the last reset.
+/// </summary>
+void vc_arena_reset(VCARENA* arena) {
+	VCARENABLOCK* block;
+	VCARENABLOCK* merged;
+	size_t size = 0;
+
+	if (arena == NULL) return;
+
+	if (arena->blocks->next != NULL) {
+		// Grew during the frame: replace the chain by one block of the total size.
+		// If that cannot be allocated, the first block (the largest) is kept.
+		for (block = arena->blocks; block != NULL; block = block->next) size += block->size;
+		merged = vc_arena_block_new(size, NULL);
+		if (merged == NULL) merged = vc_arena_block_new(arena->peak, NULL);
+		if (merged == NULL) {
+			merged = arena->blocks;
+			arena->blocks = merged->next;
+			merged->next = NULL;
+		}
+		while (arena->blocks != NULL) {
+			block = arena->blocks;
+			arena->blocks = block->next;
+			free(block);
+		}
+		arena->blocks = merged;
+	}
+	arena->blocks->used = 0;
+	arena->used = 0;
+}
+
+/// <summary>
+/// Allocates zeroed memory from the arena, or with calloc when arena is NULL.
+/// </summary>
+void* vc_alloc(VCARENA* arena, size_t n, size_t size) {
+	if (arena == NULL) return calloc(n, size);
+	return vc_arena_alloc(arena, n, size);
+}
+
+/// <summary>
+/// Allocates memory that is not cleared from the arena, or with malloc when arena is NULL.
+/// </summary>
+void* vc_alloc_raw(VCARENA* arena, size_t n, size_t size) {
+	if (arena == NULL) return malloc(n * size);
+	return vc_arena_alloc_raw(arena, n, size);
+}
+
+/// <summary>
+/// Frees memory from vc_alloc or vc_alloc_raw. Arena memory is only released by vc_arena_reset.
+/// </summary>
+void vc_release(VCARENA* arena, void* p) {
+	if (arena == NULL) free(p);
+}
+
+/// <summary>
+/// Creates an empty image pool. The pool is not thread safe: every thread
+/// that allocates images should have its own.
+/// </summary>
+VCPOOL* vc_pool_new(void) {
+	VCPOOL* pool = (VCPOOL*)malloc(sizeof(VCPOOL));
+
+	if (pool == NULL) return NULL;
+	pool->images = NULL;
+	pool->count = 0;
+	pool->capacity = 0;
+	return pool;
+}
+
+VCPOOL* vc_pool_free(VCPOOL* pool) {
+	int i;
+
+	if (pool != NULL) {
+		for (i = 0; i < pool->count; i++) vc_image_free(pool->images[i]);
+		free(pool->images);
+		free(pool);
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Returns an image of the given size from the pool, or a new one if the pool
+/// has none. The contents of a reused image are not cleared.
+/// </summary>
+/// <param name="pool">Pool (NULL to always allocate)</param>
+/// <returns>Pointer to the image, or NULL on error</returns>
+IVC* vc_pool_get(VCPOOL* pool, int width, int height, int channels) {
+	IVC* image;
+	int i;
+
+	if (pool != NULL) {
+		for (i = pool->count - 1; i >= 0; i--) {
+			image = pool->images[i];
+			if ((image->width == width) && (image->height == height) && (image->channels == channels)) {
+				pool->images[i] = pool->images[--pool->count];
+				return image;
+			}
+		}
+	}
+	return vc_image_new(width, height, channels, 255);
+}
+
+/// <summary>
+/// Gives an image back to the pool (or frees it when pool is NULL).
+/// </summary>
+/// <returns>Always NULL</returns>
+IVC* vc_pool_put(VCPOOL* pool, IVC* image) {
+	IVC** images;
+
+	if (image == NULL) return NULL;
+	if ((pool == NULL) || image->borrowed) return vc_image_free(image);
+
+	if (pool->count == pool->capacity) {
+		int capacity = pool->capacity ? pool->capacity * 2 : 16;
+		images = (IVC**)realloc(pool->images, capacity * sizeof(IVC*));
+		if (images == NULL) return vc_image_free(image);
+		pool->images = images;
+		pool->capacity = capacity;
+	}
+	pool->images[pool->count++] = image;
+	return NULL;
+}
@@ -14,6 +14,13 @@
 #include <malloc.h>
 #include "vc.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Scratch rows of morph_vhgw kept on the stack (a 4K row with kernel 3 fits)
+#define VC_MORPH_MAX_STACK_BYTES (64 * 1024)
+
 /// <summary>
 /// Performs binary dilation on a grayscale or RGB binary image.
 /// For each pixel, if any pixel in the kernel neighborhood is white (255),
@@ -128,3 +135,173 @@ int vc_binary_erode(IVC* src, IVC* dst, int kernel)
 
 	return 1;
 }
+
+// Max (max = 1) or min (max = 0) of two rows, pixel by pixel (dst may be a or b)
+static void morph_rows(unsigned char* dst, const unsigned char* a, const unsigned char* b, int n, int max)
+{
+	int x = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	for (; x + 16 <= n; x += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+		_mm_storeu_si128((__m128i*)(dst + x), max ? _mm_max_epu8(va, vb) : _mm_min_epu8(va, vb));
+	}
+#endif
+	if (max) for (; x < n; x++) dst[x] = a[x] > b[x] ? a[x] : b[x];
+	else for (; x < n; x++) dst[x] = a[x] < b[x] ? a[x] : b[x];
+}
+
+/// <summary>
+/// Max or min of every window of kernel pixels of a row (van Herk/Gil-Werman).
+/// The row is padded with kernel / 2 neutral values on each side and split in
+/// blocks of kernel pixels; g is the running max from the start of each block
+/// and h from its end, so every window is max(h[x], g[x + kernel - 1]).
+/// </summary>
+static void morph_row(const unsigned char* in, unsigned char* out, int width, int kernel, int max,
+	unsigned char* pad, unsigned char* g, unsigned char* h)
+{
+	int bound = (kernel - 1) / 2;
+	int len = ((width + 2 * bound + kernel - 1) / kernel) * kernel;
+	unsigned char neutral = max ? 0 : 255;
+	int b, i;
+
+	// Borders: neutral values, so the inner loops need no checks
+	memset(pad, neutral, bound);
+	memcpy(pad + bound, in, width);
+	memset(pad + bound + width, neutral, len - bound - width);
+
+	// Small kernels: kernel - 1 vectorisable passes beat the serial running max
+	if (kernel <= 5) {
+		memcpy(out, pad, width);
+		for (i = 1; i < kernel; i++) morph_rows(out, out, pad + i, width, max);
+		return;
+	}
+
+	for (b = 0; b < len; b += kernel) {
+		g[b] = pad[b];
+		h[b + kernel - 1] = pad[b + kernel - 1];
+		if (max) {
+			for (i = b + 1; i < b + kernel; i++) g[i] = g[i - 1] > pad[i] ? g[i - 1] : pad[i];
+			for (i = b + kernel - 2; i >= b; i--) h[i] = h[i + 1] > pad[i] ? h[i + 1] : pad[i];
+		}
+		else {
+			for (i = b + 1; i < b + kernel; i++) g[i] = g[i - 1] < pad[i] ? g[i - 1] : pad[i];
+			for (i = b + kernel - 2; i >= b; i--) h[i] = h[i + 1] < pad[i] ? h[i + 1] : pad[i];
+		}
+	}
+	morph_rows(out, h, g + kernel - 1, width, max);
+}
+
+/// <summary>
+/// Separable max (max = 1) or min filter with a square kernel, at a cost per
+/// pixel that does not depend on the kernel size. Rows are filtered with
+/// morph_row as they are loaded, a block of kernel rows at a time, and the
+/// columns with the same prefix/suffix scheme applied to whole rows. Pixels
+/// outside the image are ignored, as in vc_binary_dilate/vc_binary_erode.
+/// Rows are written only after they have been read, so dst may be src.
+/// </summary>
+static int morph_vhgw(IVC* src, IVC* dst, int kernel, int max)
+{
+	if (!src || !dst || kernel < 1 || kernel % 2 == 0) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 1) || (dst->channels != 1)) return 0;
+
+	int width = src->width;
+	int height = src->height;
+	int bound = (kernel - 1) / 2;
+	int rowlen = width + 2 * kernel;
+	int nblocks = (height + 2 * bound + kernel - 1) / kernel;
+	unsigned char neutral = max ? 0 : 255;
+	unsigned char stack[VC_MORPH_MAX_STACK_BYTES];
+	unsigned char *buffer, *rows, *g, *h, *hprev, *tmp, *pad, *rg, *rh;
+	size_t size = (size_t)4 * kernel * width + 3 * rowlen;
+	int j, i, p, y;
+
+	// Block of filtered rows, prefix rows, suffix rows of this and the previous block
+	buffer = size <= VC_MORPH_MAX_STACK_BYTES ? stack : (unsigned char*)malloc(size);
+	if (buffer == NULL) return 0;
+	rows = buffer;
+	g = rows + (size_t)kernel * width;
+	h = g + (size_t)kernel * width;
+	hprev = h + (size_t)kernel * width;
+	pad = hprev + (size_t)kernel * width;
+	rg = pad + rowlen;
+	rh = rg + rowlen;
+
+	// Padded row p is image row p - bound; block nblocks only completes the last outputs
+	for (j = 0; j <= nblocks; j++) {
+		for (i = 0; i < kernel; i++) {
+			unsigned char* row = rows + (size_t)i * width;
+			p = j * kernel + i - bound;
+			if ((j < nblocks) && (p >= 0) && (p < height)) morph_row(src->data + p * src->bytesperline, row, width, kernel, max, pad, rg, rh);
+			else memset(row, neutral, width);
+		}
+
+		memcpy(g, rows, width);
+		for (i = 1; i < kernel; i++) morph_rows(g + (size_t)i * width, g + (size_t)(i - 1) * width, rows + (size_t)i * width, width, max);
+		memcpy(h + (size_t)(kernel - 1) * width, rows + (size_t)(kernel - 1) * width, width);
+		for (i = kernel - 2; i >= 0; i--) morph_rows(h + (size_t)i * width, h + (size_t)(i + 1) * width, rows + (size_t)i * width, width, max);
+
+		// Output row y covers padded rows y to y + kernel - 1: the suffix of its
+		// block (previous one) and the prefix of this block
+		for (i = 0; j > 0 && i < kernel; i++) {
+			y = (j - 1) * kernel + i;
+			if (y >= height) break;
+			unsigned char* out = dst->data + y * dst->bytesperline;
+			if (i == 0) memcpy(out, hprev, width);
+			else morph_rows(out, hprev + (size_t)i * width, g + (size_t)(i - 1) * width, width, max);
+		}
+
+		tmp = hprev;
+		hprev = h;
+		h = tmp;
+	}
+
+	if (buffer != stack) free(buffer);
+	return 1;
+}
+
+/// <summary>
+/// Binary dilation with a cost per pixel independent of the kernel size
+/// (van Herk/Gil-Werman). Same result as vc_binary_dilate on 0/255 images;
+/// on grey-level images it is a max filter.
+/// </summary>
+/// <param name="src">Source binary image (1 channel)</param>
+/// <param name="dst">Destination image (may be src)</param>
+/// <param name="kernel">Size of the square structuring element (must be odd)</param>
+/// <returns>Returns 1 on success, 0 on failure</returns>
+int vc_binary_dilate_vhgw(IVC* src, IVC* dst, int kernel)
+{
+	return morph_vhgw(src, dst, kernel, 1);
+}
+
+/// <summary>
+/// Binary erosion with a cost per pixel independent of the kernel size
+/// (van Herk/Gil-Werman). Same result as vc_binary_erode on 0/255 images;
+/// on grey-level images it is a min filter.
+/// </summary>
+/// <param name="src">Source binary image (1 channel)</param>
+/// <param name="dst">Destination image (may be src)</param>
+/// <param name="kernel">Size of the square structuring element (must be odd)</param>
+/// <returns>Returns 1 on success, 0 on failure</returns>
+int vc_binary_erode_vhgw(IVC* src, IVC* dst, int kernel)
+{
+	return morph_vhgw(src, dst, kernel, 0);
+}
+
+/// <summary>
+/// Binary closing (dilation followed by erosion) with a cost per pixel
+/// independent of the kernel size. Same result as vc_binary_dilate into a
+/// temporary image followed by vc_binary_erode, but the erosion runs in place
+/// on dst, so no intermediate image is needed.
+/// </summary>
+/// <param name="src">Source binary image (1 channel)</param>
+/// <param name="dst">Destination image (may be src)</param>
+/// <param name="kernel">Size of the square structuring element (must be odd)</param>
+/// <returns>Returns 1 on success, 0 on failure</returns>
+int vc_binary_close(IVC* src, IVC* dst, int kernel)
+{
+	if (!morph_vhgw(src, dst, kernel, 1)) return 0;
+	return morph_vhgw(dst, dst, kernel, 0);
+}
@@ -0,0 +1,340 @@
+/*****************************************************************//**
+ * \file   parallel.cpp
+ * \brief  Persistent thread pool and row-band parallel versions of the
+ *         per-pixel vc_* kernels (C interface, declared in vc.h).
+ *
+ * The image is split into horizontal bands and every band is one job of the
+ * pool; the calling thread works on bands too. Pointwise kernels run the
+ * serial kernel on views of the band rows. Neighbourhood kernels also read
+ * halo rows above and below the band, so every band gives exactly the pixels
+ * the serial kernel gives on the whole image.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "vc.h"
+
+namespace {
+
+// Smallest band worth a job of its own
+const long MIN_BAND_PIXELS = 32 * 1024;
+
+class ThreadPool {
+public:
+	~ThreadPool() { resize(1); }
+
+	/// <summary>
+	/// Sets the number of threads working on a job (the caller and nthreads - 1 workers).
+	/// </summary>
+	void resize(int nthreads) {
+		std::lock_guard<std::mutex> lock(busy);
+		{
+			std::lock_guard<std::mutex> state(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) worker.join();
+		workers.clear();
+		quit = false;
+		for (int i = 1; i < nthreads; i++) workers.emplace_back(&ThreadPool::worker, this);
+		size = nthreads;
+	}
+
+	int threads() const { return size; }
+
+	/// <summary>
+	/// Runs fn(band) for every band in [0, nbands) and waits for all of them.
+	/// Only one job runs at a time: when the pool is busy (e.g. kernels called
+	/// from several detection threads) the caller runs the bands itself.
+	/// </summary>
+	void run(int nbands, const std::function<void(int)>& fn) {
+		std::unique_lock<std::mutex> owner(busy, std::try_to_lock);
+		if (!owner.owns_lock() || workers.empty()) {
+			for (int band = 0; band < nbands; band++) fn(band);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		job = &fn;
+		total = nbands;
+		next = 0;
+		finished = 0;
+		generation++;
+		lock.unlock();
+		wake.notify_all();
+
+		int n = work(fn);
+
+		lock.lock();
+		finished += n;
+		done.wait(lock, [this] { return finished == total && active == 0; });
+		job = nullptr;
+	}
+
+private:
+	// Claims bands until there are none left, returns how many were run
+	int work(const std::function<void(int)>& fn) {
+		int n = 0;
+		for (int band = next++; band < total; band = next++, n++) fn(band);
+		return n;
+	}
+
+	void worker() {
+		unsigned long seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			wake.wait(lock, [&] { return quit || (job != nullptr && generation != seen); });
+			if (quit) return;
+			seen = generation;
+			const std::function<void(int)>* fn = job;
+			// The job (and fn) stays alive until every worker that took it is done
+			active++;
+			lock.unlock();
+			int n = work(*fn);
+			lock.lock();
+			active--;
+			finished += n;
+			if ((finished == total) && (active == 0)) done.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	int size = 1;
+	std::mutex busy;				// Held by the thread that owns the current job
+	std::mutex mutex;				// Protects the job state below
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int)>* job = nullptr;
+	unsigned long generation = 0;
+	std::atomic<int> next{ 0 };
+	int total = 0;
+	int finished = 0;
+	int active = 0;
+	bool quit = false;
+};
+
+ThreadPool& pool() {
+	static ThreadPool instance;
+	return instance;
+}
+
+// Number of bands for an image, 1 when it is too small to split
+int band_count(const IVC* image) {
+	long pixels = (long)image->width * image->height;
+	long bands = std::min<long>(pool().threads(), pixels / MIN_BAND_PIXELS);
+	return bands > 1 ? (int)bands : 1;
+}
+
+// Rows [y0, y1) of image, without a copy
+IVC rows_view(const IVC* image, int y0, int y1) {
+	IVC view = *image;
+	view.data = image->data + (long)y0 * image->bytesperline;
+	view.height = y1 - y0;
+	view.borrowed = 1;
+	return view;
+}
+
+/// <summary>
+/// Runs kernel(src band, dst band) on every band of rows. dst may be NULL for
+/// kernels with a single image.
+/// </summary>
+/// <returns>1 if every band succeeded, 0 otherwise</returns>
+int pointwise(IVC* src, IVC* dst, const std::function<int(IVC*, IVC*)>& kernel) {
+	int nbands = band_count(src);
+	if ((nbands == 1) || (src->data == NULL) || ((dst != NULL) && (dst->height != src->height))) return kernel(src, dst);
+
+	std::atomic<int> ok{ 1 };
+	pool().run(nbands, [&](int band) {
+		int y0 = (int)((long)src->height * band / nbands);
+		int y1 = (int)((long)src->height * (band + 1) / nbands);
+		IVC s = rows_view(src, y0, y1);
+		IVC d = dst != NULL ? rows_view(dst, y0, y1) : IVC();
+		if (!kernel(&s, dst != NULL ? &d : NULL)) ok = 0;
+	});
+	return ok;
+}
+
+/// <summary>
+/// Same as pointwise, for kernels that write a packed mask: the rows of a
+/// packed mask are independent, so it is split into the same bands as src.
+/// </summary>
+/// <returns>1 if every band succeeded, 0 otherwise</returns>
+int pointwise_bits(IVC* src, BVC* dst, const std::function<int(IVC*, BVC*)>& kernel) {
+	int nbands = band_count(src);
+	if ((nbands == 1) || (src->data == NULL) || (dst->height != src->height)) return kernel(src, dst);
+
+	std::atomic<int> ok{ 1 };
+	pool().run(nbands, [&](int band) {
+		int y0 = (int)((long)src->height * band / nbands);
+		int y1 = (int)((long)src->height * (band + 1) / nbands);
+		IVC s = rows_view(src, y0, y1);
+		BVC d = *dst;
+		d.data = dst->data + (size_t)y0 * dst->words;
+		d.height = y1 - y0;
+		if (!kernel(&s, &d)) ok = 0;
+	});
+	return ok;
+}
+
+/// <summary>
+/// Runs a kernel that reads up to halo rows above and below every output row
+/// and writes every row of dst. Each band runs it on its rows plus the halo
+/// into a buffer of the thread, then copies its own rows to dst.
+/// </summary>
+/// <returns>1 if every band succeeded, 0 otherwise</returns>
+int neighbourhood(IVC* src, IVC* dst, int halo, const std::function<int(IVC*, IVC*)>& kernel) {
+	int nbands = band_count(src);
+	if ((nbands == 1) || (src->data == NULL) || (dst->data == NULL) || (src == dst)) return kernel(src, dst);
+	if ((dst->width != src->width) || (dst->height != src->height) || (dst->channels != src->channels)) return kernel(src, dst);
+
+	std::atomic<int> ok{ 1 };
+	pool().run(nbands, [&](int band) {
+		thread_local std::vector<unsigned char> scratch;
+		int y0 = (int)((long)src->height * band / nbands);
+		int y1 = (int)((long)src->height * (band + 1) / nbands);
+		int h0 = std::max(0, y0 - halo);
+		int h1 = std::min(src->height, y1 + halo);
+		IVC s = rows_view(src, h0, h1);
+		IVC d = s;
+
+		scratch.resize((size_t)(h1 - h0) * src->bytesperline);
+		d.data = scratch.data();
+		if (!kernel(&s, &d)) {
+			ok = 0;
+			return;
+		}
+		for (int y = y0; y < y1; y++) {
+			memcpy(dst->data + (long)y * dst->bytesperline, d.data + (long)(y - h0) * d.bytesperline, (size_t)src->width * src->channels);
+		}
+	});
+	return ok;
+}
+
+}
+
+extern "C" {
+
+int vc_parallel_set_threads(int nthreads) {
+	if (nthreads <= 0) nthreads = (int)std::thread::hardware_concurrency();
+	if (nthreads <= 0) nthreads = 1;
+	if (nthreads != pool().threads()) pool().resize(nthreads);
+	return nthreads;
+}
+
+int vc_parallel_threads(void) {
+	return pool().threads();
+}
+
+int vc_rgb_to_hsv_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_rgb_to_hsv(s, d); });
+}
+
+int vc_rgb_to_hsv_fixed_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_rgb_to_hsv_fixed(s, d); });
+}
+
+int vc_gbr_rgb_mt(IVC* src) {
+	return pointwise(src, NULL, [](IVC* s, IVC*) { return vc_gbr_rgb(s); });
+}
+
+int vc_hsv_segmentation_mt(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax) {
+	return pointwise(src, dst, [=](IVC* s, IVC* d) { return vc_hsv_segmentation(s, d, hmin, hmax, smin, smax, vmin, vmax); });
+}
+
+int vc_bgr_to_mask_mt(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges) {
+	return pointwise(src, dst, [=](IVC* s, IVC* d) { return vc_bgr_to_mask(s, d, ranges, nranges); });
+}
+
+int vc_bgr_to_mask_lut_mt(IVC* src, IVC* dst, const HSVLUT* lut) {
+	return pointwise(src, dst, [=](IVC* s, IVC* d) { return vc_bgr_to_mask_lut(s, d, lut); });
+}
+
+int vc_bgr_to_mask_fixed_mt(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges) {
+	return pointwise(src, dst, [=](IVC* s, IVC* d) { return vc_bgr_to_mask_fixed(s, d, ranges, nranges); });
+}
+
+int vc_bgr_to_bits_mt(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges) {
+	return pointwise_bits(src, dst, [=](IVC* s, BVC* d) { return vc_bgr_to_bits(s, d, ranges, nranges); });
+}
+
+int vc_bgr_to_bits_lut_mt(IVC* src, BVC* dst, const HSVLUT* lut) {
+	return pointwise_bits(src, dst, [=](IVC* s, BVC* d) { return vc_bgr_to_bits_lut(s, d, lut); });
+}
+
+int vc_bgr_to_bits_fixed_mt(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges) {
+	return pointwise_bits(src, dst, [=](IVC* s, BVC* d) { return vc_bgr_to_bits_fixed(s, d, ranges, nranges); });
+}
+
+int vc_add_image_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_add_image(s, d); });
+}
+
+int vc_three_to_one_channel_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_three_to_one_channel(s, d); });
+}
+
+int vc_one_to_three_channel_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_one_to_three_channel(s, d); });
+}
+
+int vc_draw_edge_mt(IVC* src, IVC* dst) {
+	return pointwise(src, dst, [](IVC* s, IVC* d) { return vc_draw_edge(s, d); });
+}
+
+int vc_binary_dilate_mt(IVC* src, IVC* dst, int kernel) {
+	return neighbourhood(src, dst, kernel / 2, [=](IVC* s, IVC* d) { return vc_binary_dilate(s, d, kernel); });
+}
+
+int vc_binary_erode_mt(IVC* src, IVC* dst, int kernel) {
+	return neighbourhood(src, dst, kernel / 2, [=](IVC* s, IVC* d) { return vc_binary_erode(s, d, kernel); });
+}
+
+int vc_binary_close_mt(IVC* src, IVC* dst, int kernel) {
+	// The erosion reads kernel / 2 rows of the dilation, which reads kernel / 2 more
+	return neighbourhood(src, dst, 2 * (kernel / 2), [=](IVC* s, IVC* d) { return vc_binary_close(s, d, kernel); });
+}
+
+int vc_median5_mt(IVC* src, IVC* dst) {
+	int nbands = band_count(src);
+	if ((nbands == 1) || (src->data == NULL) || (dst->height != src->height)) return vc_median5(src, dst);
+
+	// Every band reads its own halo rows from src and writes only its rows
+	std::atomic<int> ok{ 1 };
+	pool().run(nbands, [&](int band) {
+		int y0 = (int)((long)src->height * band / nbands);
+		int y1 = (int)((long)src->height * (band + 1) / nbands);
+		IVC d = rows_view(dst, y0, y1);
+		if (!vc_median5_rows(src, y0, y1, &d)) ok = 0;
+	});
+	return ok;
+}
+
+int vc_gray_edge_prewitt_mt(IVC* src, IVC* dst) {
+	int nbands = band_count(src);
+	if ((nbands == 1) || (src->data == NULL) || (dst->height != src->height)) return vc_gray_edge_prewitt(src, dst);
+
+	// Prewitt leaves the first and last row of its image alone: each band gets
+	// one halo row on each side and writes exactly its own rows
+	std::atomic<int> ok{ 1 };
+	pool().run(nbands, [&](int band) {
+		int y0 = (int)((long)src->height * band / nbands);
+		int y1 = (int)((long)src->height * (band + 1) / nbands);
+		int h0 = std::max(0, y0 - 1);
+		int h1 = std::min(src->height, y1 + 1);
+		IVC s = rows_view(src, h0, h1);
+		IVC d = rows_view(dst, h0, h1);
+		if (!vc_gray_edge_prewitt(&s, &d)) ok = 0;
+	});
+	return ok;
+}
+
+}
@@ -0,0 +1,962 @@
+/*****************************************************************//**
+ * \file   pipeline.cpp
+ * \brief  Frame processing stages and the threaded pipeline.
+ *
+ * The video is processed by four kinds of stages, each on its own thread:
+ * decode -> detect (1..N workers) -> count -> render. Stages are connected
+ * by bounded SPSC rings of FrameSlot pointers; the render stage hands the
+ * slots back to the decoder so no frame buffers are allocated after start.
+ * Frames are dealt to the detection workers round-robin and collected in
+ * the same order, so the counter always sees the frames in video order.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include "pipeline.hpp"
+#include "ringbuffer.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#pragma region Stages
+
+/// <summary>
+/// Adds one coin, identified by vc_coin_classify, to the counters.
+/// </summary>
+static void count_coin(Counts& c, int coin) {
+	switch (coin) {
+	case 200: c.m200++; c.soma += 2; break;
+	case 100: c.m100++; c.soma += 1; break;
+	case 50: c.m50++; c.soma += 0.5; break;
+	case 20: c.m20++; c.soma += 0.2; break;
+	case 10: c.m10++; c.soma += 0.1; break;
+	case 5: c.m5++; c.soma += 0.05; break;
+	case 2: c.m2++; c.soma += 0.02; break;
+	case 1: c.m1++; c.soma += 0.01; break;
+	default: return;
+	}
+	c.cont2++;
+}
+
+static void draw_counts(cv::Mat& frame, const Counts& c) {
+	const char* labels[] = { "Moedas de 200 : ", "Moedas de 100 : ", "Moedas de 50 : ", "Moedas de 20 : ", "Moedas de 10 : ",
+		"Moedas de 5 : ", "Moedas de 2 : ", "Moedas de 1 : ", "Total : ", "Total Moedas: " };
+	std::string values[] = { std::to_string(c.m200), std::to_string(c.m100), std::to_string(c.m50), std::to_string(c.m20), std::to_string(c.m10),
+		std::to_string(c.m5), std::to_string(c.m2), std::to_string(c.m1), std::to_string(c.soma), std::to_string(c.cont2) };
+
+	for (int i = 0; i < 10; i++) {
+		std::string str = std::string(labels[i]).append(values[i]);
+		cv::putText(frame, str, cv::Point(20, 25 * (i + 1)), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(255, 0, 0), 2);
+	}
+}
+
+static void draw_blob_info(cv::Mat& frame, OVC* blobs, int nlabels) {
+	std::string str;
+	for (int i = 0; i < nlabels; i++) {
+		str = std::string("CENTRO DE MASSA : ").append(std::to_string(blobs[i].xc)).append(", y: ").append(std::to_string(blobs[i].yc));
+		cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 40), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
+		str = std::string("Area : ").append(std::to_string(blobs[i].area));
+		cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 20), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
+		str = std::string("Perimetro : ").append(std::to_string(blobs[i].perimeter));
+		cv::putText(frame, str, cv::Point(blobs[i].xc + 90, blobs[i].yc - 0), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0), 2);
+	}
+}
+
+// Non-owning IVC over the pixels of a cv::Mat (no copy)
+static IVC mat_view(const cv::Mat& mat) {
+	IVC view;
+	view.data = mat.data;
+	view.width = mat.cols;
+	view.height = mat.rows;
+	view.channels = mat.channels();
+	view.levels = 255;
+	view.bytesperline = (int)mat.step;
+	view.borrowed = 1;
+	return view;
+}
+
+FrameSlot* frame_slot_new(int width, int height, VCPOOL* pool) {
+	FrameSlot* slot = new FrameSlot();
+	slot->mask = vc_pool_get(pool, width, height, 1);
+	slot->arena = vc_arena_new(64 * 1024);
+	slot->blobs = NULL;
+	slot->contours = NULL;
+	slot->nlabels = 0;
+	slot->detect = true;
+	return slot;
+}
+
+void frame_slot_free(FrameSlot* slot, VCPOOL* pool) {
+	if (slot == NULL) return;
+	vc_pool_put(pool, slot->mask);
+	vc_arena_free(slot->arena);
+	delete slot;
+}
+
+// HSV ranges that make up the coin mask
+static const HSVRANGE coinColors[] = {
+	{ 40, 60, 20, 80, 15, 55 },
+	{ 19, 38, 37, 82, 13, 47 },
+	{ 40, 200, 4, 24, 15, 50 },
+};
+#define NCOINCOLORS (int)(sizeof(coinColors) / sizeof(coinColors[0]))
+
+// Bytes of strip buffers per frame row and pixel: frame, median, mask and closing
+#define STRIP_BYTES_PER_PIXEL 8
+// Strip buffers of the automatic strip height, about the size of an L2 cache
+#define STRIP_BUDGET (512 * 1024)
+
+// Non-owning IVC over rows [y0, y1) of image
+static IVC rows_view(const IVC* image, int y0, int y1) {
+	IVC view = *image;
+	view.data = image->data + (long)y0 * image->bytesperline;
+	view.height = y1 - y0;
+	view.borrowed = 1;
+	return view;
+}
+
+// Non-owning IVC over a rectangle of image
+static IVC rect_view(const IVC* image, const cv::Rect& r) {
+	IVC view = rows_view(image, r.y, r.y + r.height);
+	view.data += r.x * image->channels;
+	view.width = r.width;
+	return view;
+}
+
+// r grown by n pixels on every side, inside a width x height image
+static cv::Rect grow_rect(const cv::Rect& r, int n, int width, int height) {
+	int x0 = std::max(0, r.x - n);
+	int y0 = std::max(0, r.y - n);
+	int x1 = std::min(width, r.x + r.width + n);
+	int y1 = std::min(height, r.y + r.height + n);
+	return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Tiles of the incremental mode
+#define INCREMENTAL_TILE 64
+
+/// <summary>
+/// Returns the colour lookup table of the coin ranges with the given index bits.
+/// Tables are built once and shared by every detector of the process.
+/// </summary>
+static const HSVLUT* coin_lut(int bits) {
+	static std::mutex mutex;
+	static std::map<int, HSVLUT*> tables;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	HSVLUT*& lut = tables[bits];
+	if (lut == NULL) lut = vc_hsv_lut_new(bits);
+	if (lut == NULL) return NULL;
+	vc_hsv_lut_set(lut, coinColors, NCOINCOLORS);
+	return lut;
+}
+
+Detector::Detector(const std::vector<cv::Rect>& rects, int width, int height, const Options& opt, VCPOOL* pool)
+	: lut(opt.lutBits ? coin_lut(opt.lutBits) : NULL), fixedHsv(opt.fixedHsv), cvMedian(opt.cvMedian), overlay(!opt.headless), keepMask(!opt.headless && !opt.contours), contours(opt.contours), masks(opt.masks), closeKernel(opt.closeKernel), incremental(opt.incremental), pool(pool) {
+	stripRows = 0;
+	if ((opt.stripRows >= 0) && (masks == MASK_IMAGE)) {
+		stripRows = opt.stripRows > 0 ? opt.stripRows : std::max(16, STRIP_BUDGET / (STRIP_BYTES_PER_PIXEL * width));
+	}
+	for (const cv::Rect& rect : rects) {
+		Band band;
+		band.rect = rect;
+		band.full = rect.x == 0 && rect.y == 0 && rect.width == width && rect.height == height;
+		// Runs and bits are labelled without a byte mask: band.mask is only drawn
+		bool bytes = masks == MASK_IMAGE;
+		band.imageA = bytes ? vc_pool_get(pool, rect.width, rect.height, 1) : NULL;
+		band.mask = (bytes || (keepMask && !band.full)) ? vc_pool_get(pool, rect.width, rect.height, 1) : NULL;
+		band.labels = vc_labels_new(rect.width, rect.height);
+		band.runsA = masks == MASK_RLE ? vc_rle_new(rect.width, rect.height) : NULL;
+		band.runsB = masks == MASK_RLE ? vc_rle_new(rect.width, rect.height) : NULL;
+		band.bitsA = masks == MASK_BITS ? vc_bits_new(rect.width, rect.height) : NULL;
+		band.bitsB = masks == MASK_BITS ? vc_bits_new(rect.width, rect.height) : NULL;
+		// The closing of a strip reads 2 * (kernel / 2) mask rows above and below it
+		int windowRows = std::min(rect.height, stripRows + 4 * (closeKernel / 2));
+		band.window = stripRows > 0 ? vc_pool_get(pool, rect.width, windowRows, 1) : NULL;
+		band.closed = stripRows > 0 ? vc_pool_get(pool, rect.width, windowRows, 1) : NULL;
+		band.cached = incremental >= 0 ? vc_pool_get(pool, rect.width, rect.height, 1) : NULL;
+		band.tileClosed = incremental >= 0 ? vc_pool_get(pool, rect.width, rect.height, 1) : NULL;
+		bands.push_back(band);
+	}
+}
+
+Detector::~Detector() {
+	for (Band& band : bands) {
+		vc_pool_put(pool, band.imageA);
+		vc_pool_put(pool, band.mask);
+		vc_labels_free(band.labels);
+		vc_rle_free(band.runsA);
+		vc_rle_free(band.runsB);
+		vc_bits_free(band.bitsA);
+		vc_bits_free(band.bitsB);
+		vc_pool_put(pool, band.window);
+		vc_pool_put(pool, band.closed);
+		vc_pool_put(pool, band.cached);
+		vc_pool_put(pool, band.tileClosed);
+	}
+}
+
+void Detector::run(FrameSlot& slot) {
+	// Everything allocated for the previous use of this slot is released here
+	vc_arena_reset(slot.arena);
+	found.clear();
+	outlines.clear();
+	if (keepMask && !(bands.size() == 1 && bands[0].full)) {
+		memset(slot.mask->data, 0, slot.mask->bytesperline * slot.mask->height);
+	}
+
+	for (Band& band : bands) {
+		cv::Mat& blurred = band.full ? slot.blurred : band.blurred;
+		int nfound = (int)found.size();
+		int nlabels = 0;
+
+		// The whole-frame band closes straight into the overlay mask (incremental
+		// mode: band.mask keeps the overlay mask of the cached blobs)
+		IVC* mask = (keepMask && band.full && (incremental < 0)) ? slot.mask : band.mask;
+		bool rle = masks == MASK_RLE;
+		bool reuse = false;
+		OVC* blobs;
+		if (incremental >= 0) {
+			bool changed = update_tiles(band, band.full ? slot.frame : slot.frame(band.rect), (overlay && band.full) ? &band.blurred : NULL);
+			if (overlay && band.full) band.blurred.copyTo(blurred);
+			// Same closed mask: same blobs, no labelling
+			reuse = !changed;
+			if (reuse) {
+				nlabels = (int)band.accepted.size();
+				blobs = nlabels > 0 ? (OVC*)vc_arena_alloc(slot.arena, nlabels, sizeof(OVC)) : NULL;
+				if (blobs != NULL) memcpy(blobs, band.accepted.data(), nlabels * sizeof(OVC));
+				else nlabels = 0;
+			}
+			else blobs = vc_binary_blob_labelling_uf(band.cached, band.labels, &nlabels, slot.arena);
+		}
+		else if (stripRows > 0) {
+			// The overlay needs the median of the whole frame, the detector only the mask
+			close_strips(band, band.full ? slot.frame : slot.frame(band.rect), (overlay && band.full) ? &blurred : NULL, mask);
+			blobs = vc_binary_blob_labelling_uf(mask, band.labels, &nlabels, slot.arena);
+		}
+		else if (rle) {
+			median(band.full ? slot.frame : slot.frame(band.rect), blurred);
+			IVC image = mat_view(blurred);
+			// Runs only: the mask is decoded for the overlay
+			if (lut != NULL) vc_bgr_to_rle_lut(&image, band.runsA, lut);
+			else if (fixedHsv) vc_bgr_to_rle_fixed(&image, band.runsA, coinColors, NCOINCOLORS);
+			else vc_bgr_to_rle(&image, band.runsA, coinColors, NCOINCOLORS);
+			vc_rle_dilate(band.runsA, band.runsB, closeKernel);
+			vc_rle_erode(band.runsB, band.runsA, closeKernel);
+			blobs = vc_rle_blob_labelling(band.runsA, &nlabels, slot.arena);
+		}
+		else {
+			median(band.full ? slot.frame : slot.frame(band.rect), blurred);
+			IVC image = mat_view(blurred);
+			if (masks == MASK_BITS) {
+				segment_bits(&image, band.bitsA);
+				vc_bits_dilate(band.bitsA, band.bitsB, closeKernel);
+				vc_bits_erode(band.bitsB, band.bitsA, closeKernel);
+				blobs = vc_bits_blob_labelling_uf(band.bitsA, band.labels, &nlabels, slot.arena);
+			}
+			else {
+				segment(&image, band.imageA);
+				vc_binary_close_mt(band.imageA, mask, closeKernel);
+				blobs = vc_binary_blob_labelling_uf(mask, band.labels, &nlabels, slot.arena);
+			}
+		}
+		int* remap = (blobs != NULL && !reuse) ? (int*)vc_arena_alloc(slot.arena, nlabels + 1, sizeof(int)) : NULL;
+		CVC* traced = NULL;
+		if (reuse) {
+			// The cached blobs keep the labels of band.labels, their contours are traced again
+			if (contours && (blobs != NULL)) {
+				traced = (CVC*)vc_arena_alloc(slot.arena, nlabels, sizeof(CVC));
+				if ((traced != NULL) && !vc_label_contours(band.labels, blobs, nlabels, traced, slot.arena)) traced = NULL;
+			}
+		}
+		else if (remap != NULL) {
+			int nblobs = nlabels;
+			if (rle) vc_rle_blob_info(band.runsA, blobs, nlabels, slot.arena);
+			else vc_label_blob_info(band.labels, blobs, nlabels, slot.arena);
+			blobs = vc_check_if_circle_remap(blobs, &nlabels, remap);
+			if (contours && (blobs != NULL)) {
+				// band.labels is not remapped: trace each blob with its old label
+				for (int l = 1; l <= nblobs; l++) {
+					if (remap[l] != 0) blobs[remap[l] - 1].label = l;
+				}
+				traced = (CVC*)vc_arena_alloc(slot.arena, nlabels, sizeof(CVC));
+				if ((traced != NULL) && !vc_label_contours(band.labels, blobs, nlabels, traced, slot.arena)) traced = NULL;
+			}
+			// Rejected blobs only have to leave the mask when it is drawn
+			if (keepMask && rle) {
+				vc_rle_remap(band.runsA, remap);
+				vc_rle_to_image(band.runsA, mask);
+			}
+			else if (keepMask) vc_labels_remap(band.labels, remap, mask);
+		}
+		else {
+			blobs = NULL;
+			if (keepMask && rle) vc_rle_to_image(band.runsA, mask);
+			else if (keepMask && (incremental >= 0)) vc_paste_roi(band.cached, mask, 0, 0);
+		}
+		if ((incremental >= 0) && !reuse) {
+			if (blobs != NULL) band.accepted.assign(blobs, blobs + nlabels);
+			else band.accepted.clear();
+		}
+		for (int i = 0; blobs != NULL && i < nlabels; i++) {
+			OVC blob = blobs[i];
+			blob.x += band.rect.x;
+			blob.xf += band.rect.x;
+			blob.xc += band.rect.x;
+			blob.y += band.rect.y;
+			blob.yf += band.rect.y;
+			blob.yc += band.rect.y;
+			// Bands of neighbouring lanes may overlap: keep each coin once
+			if (vc_main_collisions(blob, found.data(), nfound)) continue;
+			found.push_back(blob);
+			if (contours) {
+				CVC outline = traced != NULL ? traced[i] : CVC();
+				outline.x += band.rect.x;
+				outline.y += band.rect.y;
+				outlines.push_back(outline);
+			}
+		}
+
+		if (keepMask && (!band.full || (incremental >= 0))) vc_paste_roi(band.mask, slot.mask, band.rect.x, band.rect.y);
+	}
+
+	slot.nlabels = (int)found.size();
+	slot.blobs = slot.nlabels > 0 ? (OVC*)vc_arena_alloc(slot.arena, slot.nlabels, sizeof(OVC)) : NULL;
+	if (slot.blobs != NULL) memcpy(slot.blobs, found.data(), slot.nlabels * sizeof(OVC));
+	else slot.nlabels = 0;
+	slot.contours = (contours && slot.nlabels > 0) ? (CVC*)vc_arena_alloc(slot.arena, slot.nlabels, sizeof(CVC)) : NULL;
+	if (slot.contours != NULL) memcpy(slot.contours, outlines.data(), slot.nlabels * sizeof(CVC));
+}
+
+/// <summary>
+/// 5x5 median filter of the frame (or band) before the segmentation.
+/// </summary>
+void Detector::median(const cv::Mat& src, cv::Mat& dst) {
+	if (cvMedian) {
+		cv::medianBlur(src, dst, 5);
+		return;
+	}
+	dst.create(src.rows, src.cols, src.type());
+	IVC in = mat_view(src);
+	IVC out = mat_view(dst);
+	vc_median5_mt(&in, &out);
+}
+
+/// <summary>
+/// Colour mask of the coins.
+/// </summary>
+void Detector::segment(IVC* image, IVC* mask) {
+	if (lut != NULL) vc_bgr_to_mask_lut_mt(image, mask, lut);
+	else if (fixedHsv) vc_bgr_to_mask_fixed_mt(image, mask, coinColors, NCOINCOLORS);
+	else vc_bgr_to_mask_mt(image, mask, coinColors, NCOINCOLORS);
+}
+
+/// <summary>
+/// Colour mask of the coins, packed 1 bit per pixel.
+/// </summary>
+void Detector::segment_bits(IVC* image, BVC* mask) {
+	if (lut != NULL) vc_bgr_to_bits_lut_mt(image, mask, lut);
+	else if (fixedHsv) vc_bgr_to_bits_fixed_mt(image, mask, coinColors, NCOINCOLORS);
+	else vc_bgr_to_bits_mt(image, mask, coinColors, NCOINCOLORS);
+}
+
+/// <summary>
+/// Median, colour mask and closing of a band, one strip of rows at a time, so
+/// the intermediates of a strip are still in cache when the next step reads
+/// them. The colour mask rows the closing shares with the next strip are kept
+/// in band.window, so every row goes through the median once (plus two rows
+/// of halo per strip). Gives the same mask as the whole-frame path.
+/// </summary>
+/// <param name="band">Band, with its strip buffers</param>
+/// <param name="frame">Pixels of the band</param>
+/// <param name="blurred">Receives the median of the band, NULL if not needed</param>
+/// <param name="mask">Closed mask of the band</param>
+void Detector::close_strips(Band& band, const cv::Mat& frame, cv::Mat* blurred, IVC* mask) {
+	int width = frame.cols;
+	int height = frame.rows;
+	int halo = 2 * (closeKernel / 2);
+	int w0 = 0, w1 = 0;		// Rows of the band in band.window
+
+	if (blurred != NULL) blurred->create(height, width, frame.type());
+
+	for (int y0 = 0; y0 < height; y0 += stripRows) {
+		int y1 = std::min(height, y0 + stripRows);
+		int need0 = std::max(0, y0 - halo);
+		int need1 = std::min(height, y1 + halo);
+
+		// Mask rows shared with the previous strip move to the top of the window
+		if (w1 > need0) {
+			memmove(band.window->data, band.window->data + (long)(need0 - w0) * band.window->bytesperline, (size_t)(w1 - need0) * band.window->bytesperline);
+		}
+		else w1 = need0;
+		w0 = need0;
+
+		// Median and colour mask of the new rows
+		if (need1 > w1) {
+			cv::Mat rows;
+			if (cvMedian) {
+				// cv::medianBlur filters whole images: 2 rows of halo for the 5x5 median
+				int f0 = std::max(0, w1 - 2);
+				int f1 = std::min(height, need1 + 2);
+				cv::medianBlur(frame(cv::Rect(0, f0, width, f1 - f0)), band.stripBlur, 5);
+				rows = band.stripBlur(cv::Rect(0, w1 - f0, width, need1 - w1));
+				if (blurred != NULL) {
+					cv::Mat out = (*blurred)(cv::Rect(0, w1, width, need1 - w1));
+					rows.copyTo(out);
+				}
+			}
+			else {
+				// Only the new rows, straight into the overlay frame when there is one
+				if (blurred != NULL) rows = (*blurred)(cv::Rect(0, w1, width, need1 - w1));
+				else {
+					band.stripBlur.create(band.window->height, width, frame.type());
+					rows = band.stripBlur(cv::Rect(0, 0, width, need1 - w1));
+				}
+				IVC in = mat_view(frame);
+				IVC out = mat_view(rows);
+				vc_median5_rows(&in, w1, need1, &out);
+			}
+			IVC image = mat_view(rows);
+			IVC dst = rows_view(band.window, w1 - w0, need1 - w0);
+			segment(&image, &dst);
+			w1 = need1;
+		}
+
+		// Closing of the window; only the rows of the strip are exact
+		IVC window = rows_view(band.window, 0, w1 - w0);
+		IVC closed = rows_view(band.closed, 0, w1 - w0);
+		vc_binary_close(&window, &closed, closeKernel);
+		for (int y = y0; y < y1; y++) {
+			memcpy(mask->data + (long)y * mask->bytesperline, closed.data + (long)(y - w0) * closed.bytesperline, width);
+		}
+	}
+}
+
+/// <summary>
+/// Incremental mode: brings the closed mask of a band (band.cached) up to date
+/// with a frame. Only the tiles that changed since they were last processed go
+/// through the median and the colour mask (plus the 2 pixels around them the
+/// median reaches) and the closing (plus the pixels whose closing reads one of
+/// those); band.imageA and band.cached keep the rest. When most of the tiles
+/// changed the whole band is processed at once.
+/// </summary>
+/// <param name="band">Band, with its incremental buffers</param>
+/// <param name="frame">Pixels of the band</param>
+/// <param name="blurred">Median of the band kept for the overlay and updated the same way, NULL if not needed</param>
+/// <returns>true if band.cached changed (always on the first frame)</returns>
+bool Detector::update_tiles(Band& band, const cv::Mat& frame, cv::Mat* blurred) {
+	int width = frame.cols;
+	int height = frame.rows;
+	int ntx = (width + INCREMENTAL_TILE - 1) / INCREMENTAL_TILE;
+	int nty = (height + INCREMENTAL_TILE - 1) / INCREMENTAL_TILE;
+	int halo = 2 * (closeKernel / 2);
+	bool first = band.reference.empty();
+	int ndirty;
+
+	if (first) {
+		frame.copyTo(band.reference);
+		ndirty = ntx * nty;
+	}
+	else {
+		IVC in = mat_view(frame);
+		IVC ref = mat_view(band.reference);
+		band.dirty.resize((size_t)ntx * nty);
+		ndirty = vc_dirty_tiles(&in, &ref, INCREMENTAL_TILE, incremental, band.dirty.data());
+	}
+	if (ndirty == 0) return false;
+
+	if (2 * ndirty > ntx * nty) {
+		cv::Mat& out = blurred != NULL ? *blurred : band.tileBlur;
+		median(frame, out);
+		IVC image = mat_view(out);
+		segment(&image, band.imageA);
+		vc_binary_close_mt(band.imageA, band.tileClosed, closeKernel);
+		bool changed = first || memcmp(band.tileClosed->data, band.cached->data, (size_t)band.cached->bytesperline * height) != 0;
+		std::swap(band.cached, band.tileClosed);
+		return changed;
+	}
+
+	// Colour mask of the dirty tiles and the 2 pixels around them. Their median
+	// is exact 2 pixels from the border of the filtered rectangle.
+	for (int t = 0; t < ntx * nty; t++) {
+		if (!band.dirty[t]) continue;
+		cv::Rect tile((t % ntx) * INCREMENTAL_TILE, (t / ntx) * INCREMENTAL_TILE, INCREMENTAL_TILE, INCREMENTAL_TILE);
+		cv::Rect r = grow_rect(tile, 2, width, height);
+		cv::Rect v = grow_rect(r, 2, width, height);
+		// Filtered in the band's tile buffer, so moving footage does not allocate per tile
+		band.tileMedian.create(INCREMENTAL_TILE + 8, INCREMENTAL_TILE + 8, frame.type());
+		cv::Mat out = band.tileMedian(cv::Rect(0, 0, v.width, v.height));
+		median(frame(v), out);
+		cv::Mat inner = out(cv::Rect(r.x - v.x, r.y - v.y, r.width, r.height));
+		IVC image = mat_view(inner);
+		IVC mask = rect_view(band.imageA, r);
+		segment(&image, &mask);
+		if (blurred != NULL) {
+			cv::Mat dst = (*blurred)(r);
+			inner.copyTo(dst);
+		}
+	}
+
+	// Closing of every pixel that reads a new colour mask pixel, from the
+	// colour mask up to halo pixels further away
+	bool changed = false;
+	for (int t = 0; t < ntx * nty; t++) {
+		if (!band.dirty[t]) continue;
+		cv::Rect tile((t % ntx) * INCREMENTAL_TILE, (t / ntx) * INCREMENTAL_TILE, INCREMENTAL_TILE, INCREMENTAL_TILE);
+		cv::Rect c = grow_rect(tile, 2 + halo, width, height);
+		cv::Rect h = grow_rect(c, halo, width, height);
+		IVC src = rect_view(band.imageA, h);
+		IVC dst = rect_view(band.tileClosed, cv::Rect(0, 0, h.width, h.height));
+		vc_binary_close(&src, &dst, closeKernel);
+		for (int y = c.y; y < c.y + c.height; y++) {
+			unsigned char* pc = band.cached->data + (long)y * band.cached->bytesperline + c.x;
+			unsigned char* pt = dst.data + (long)(y - h.y) * dst.bytesperline + (c.x - h.x);
+			if (memcmp(pc, pt, c.width) == 0) continue;
+			memcpy(pc, pt, c.width);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+// The centre (x, y) of a coin is within window rows of a counting line, or went past it since row py
+bool Counter::on_line(float x, float y, float py) const {
+	for (const Lane& lane : lanes) {
+		if ((x < lane.x0) || (x > lane.x1)) continue;
+		if ((lane.y - window <= y) && (y <= lane.y + window)) return true;
+		if ((py < lane.y) != (y < lane.y)) return true;
+	}
+	return false;
+}
+
+void Counter::run(FrameSlot& slot) {
+	OVC* blobs = slot.blobs;
+	int nlabels = slot.nlabels;
+
+	if (!slot.detect) {
+		// Skipped frame: coins that reach a line now by their prediction are counted
+		// now, from the last blob of their track
+		tracker.skip();
+		for (Track& track : tracker.tracks) {
+			if (track.counted || (track.missed > 0)) continue;
+			float x = track.x + track.vx * track.since;
+			float y = track.y + track.vy * track.since;
+			if (!on_line(x, y, y - track.vy)) continue;
+			track.counted = true;
+			count_coin(counts, vc_coin_classify(rules, nrules, track.area, track.perimeter));
+		}
+		slot.counts = counts;
+		return;
+	}
+
+	tracker.update(blobs, nlabels, match);
+	for (int i = 0; i < nlabels; i++) {
+		// Every coin is counted once, the first frame it is on a line
+		Track& track = tracker.tracks[match[i]];
+		if (track.counted || !on_line(track.x, track.y, track.py)) continue;
+		track.counted = true;
+		count_coin(counts, vc_coin_classify(rules, nrules, blobs[i].area, blobs[i].perimeter));
+	}
+	plan();
+	slot.counts = counts;
+}
+
+/// <summary>
+/// Frames until the next detection: as many as the fastest coin takes to move
+/// the height of the counting window (2 * window rows), so every coin is still
+/// seen by a detection within window rows of the line, up to maxSkip. Every
+/// frame until the speed of the coins is known.
+/// </summary>
+void Counter::plan() {
+	float fastest = -1;
+	for (const Track& track : tracker.tracks) {
+		// Only tracks seen twice have a measured velocity
+		if ((track.since > 0) || (track.hits < 2)) continue;
+		fastest = std::max(fastest, std::sqrt(track.vx * track.vx + track.vy * track.vy));
+	}
+	// With no coins in view the belt keeps its last speed
+	if (fastest >= 0) speed = fastest;
+
+	int frames = 1;
+	if (speed == 0) frames = maxSkip;
+	else if (speed > 0) frames = std::max(1, std::min(maxSkip, (int)(2 * window / speed)));
+	interval.store(frames, std::memory_order_relaxed);
+}
+
+Renderer::Renderer(int width, int height, const Options& opt, VCPOOL* pool) : headless(opt.headless), fullEdges(opt.fullEdges), pool(pool) {
+	imageH = (!headless && fullEdges) ? vc_pool_get(pool, width, height, 1) : NULL;
+	// vc_gray_edge_prewitt does not write the border pixels: they stay 0
+	if (imageH != NULL) memset(imageH->data, 0, (size_t)imageH->bytesperline * height);
+}
+
+Renderer::~Renderer() {
+	vc_pool_put(pool, imageH);
+}
+
+/// <summary>
+/// Draws the overlay on slot.frame and shows it.
+/// </summary>
+/// <returns>Key pressed by the user (0 in headless mode)</returns>
+int Renderer::run(FrameSlot& slot) {
+	int key = 0;
+
+	if (!headless) {
+		// With coins the overlay goes on the filtered frame, drawn in place
+		cv::Mat& out = (slot.blobs != NULL && !slot.blurred.empty()) ? slot.blurred : slot.frame;
+		if (slot.blobs != NULL) {
+			IVC image = mat_view(out);
+			vc_draw_bounding_box(&image, slot.blobs, slot.nlabels);
+			// The outlines are already traced: no pass over the mask at all
+			if (slot.contours != NULL) vc_draw_contours(&image, slot.contours, slot.nlabels);
+			else if (fullEdges) {
+				vc_gray_edge_prewitt(slot.mask, imageH);
+				vc_draw_edge(imageH, &image);
+			}
+			// Edges only exist around the blobs: the cost follows the coins, not the frame
+			else vc_draw_blob_edges(slot.mask, &image, slot.blobs, slot.nlabels, 1);
+			vc_center(slot.blobs, &image, slot.nlabels);
+			draw_blob_info(out, slot.blobs, slot.nlabels);
+		}
+		draw_counts(out, slot.counts);
+		cv::imshow("VC - VIDEO1", out);
+		key = cv::waitKey(1);
+	}
+
+	slot.blobs = NULL;
+	slot.contours = NULL;
+	slot.nlabels = 0;
+	return key;
+}
+
+#pragma endregion
+
+#pragma region Pipeline
+
+static void pin_thread(std::thread::native_handle_type handle, int cpu) {
+	if (cpu < 0) return;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(handle, sizeof(set), &set);
+#elif defined(_WIN32)
+	SetThreadAffinityMask((HANDLE)handle, (DWORD_PTR)1 << cpu);
+#endif
+}
+
+static void pin_current_thread(int cpu) {
+	if (cpu < 0) return;
+#if defined(__linux__)
+	pin_thread(pthread_self(), cpu);
+#elif defined(_WIN32)
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#endif
+}
+
+// CPU of the n-th thread (decode, detect..., count, render), -1 if not set
+static int affinity_of(const Options& opt, int n) {
+	return n < (int)opt.affinity.size() ? opt.affinity[n] : -1;
+}
+
+// Counting lines of the video: the configured ones or the middle row of the frame
+static std::vector<Lane> counting_lanes(const Options& opt, int width, int height) {
+	std::vector<Lane> lanes = opt.lanes;
+	if (lanes.empty()) {
+		Lane lane;
+		lane.y = height / 2;
+		lanes.push_back(lane);
+	}
+	for (Lane& lane : lanes) {
+		if (lane.x1 < 0 || lane.x1 >= width) lane.x1 = width - 1;
+		if (lane.x0 < 0) lane.x0 = 0;
+	}
+	return lanes;
+}
+
+/// <summary>
+/// Regions processed by the detector: the whole frame, or in ROI mode one band
+/// per lane. A band holds every coin whose centre is within the counting
+/// window (+-20 rows) of its line, plus a halo for the median and the morphology.
+/// </summary>
+static std::vector<cv::Rect> detection_bands(const Options& opt, const std::vector<Lane>& lanes, int width, int height) {
+	std::vector<cv::Rect> rects;
+	if (!opt.roi) {
+		rects.push_back(cv::Rect(0, 0, width, height));
+		return rects;
+	}
+	int half = 20 + opt.maxCoin / 2 + 4;
+	for (const Lane& lane : lanes) {
+		int y0 = std::max(0, lane.y - half);
+		int y1 = std::min(height, lane.y + half + 1);
+		int x0 = std::max(0, lane.x0 - opt.maxCoin / 2 - 4);
+		int x1 = std::min(width, lane.x1 + opt.maxCoin / 2 + 5);
+		if (y1 > y0 && x1 > x0) rects.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+	}
+	return rects;
+}
+
+// Trace of the run (opt.record), if any
+static bool open_trace(const Options& opt, TraceWriter& trace, int width, int height, const std::vector<Lane>& lanes) {
+	if (opt.record.empty()) return true;
+	if (trace.open(opt.record, width, height, opt.maxCoin, lanes)) return true;
+	std::cerr << "Erro ao criar o trace " << opt.record << "\n";
+	return false;
+}
+
+static int run_serial(const Options& opt, cv::VideoCapture& capture, Counts& counts, VCPOOL* pool) {
+	int width = (int)capture.get(cv::CAP_PROP_FRAME_WIDTH);
+	int height = (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT);
+	std::vector<Lane> lanes = counting_lanes(opt, width, height);
+	TraceWriter trace;
+	if (!open_trace(opt, trace, width, height, lanes)) return 0;
+	FrameSlot* slot = frame_slot_new(width, height, pool);
+	Detector detector(detection_bands(opt, lanes, width, height), width, height, opt, pool);
+	Counter counter(lanes, opt);
+	Renderer renderer(width, height, opt, pool);
+	int nframes = 0;
+	int next = 0;			// Next frame to detect
+	int key = 0;
+
+	while (key != 'q') {
+		capture.read(slot->frame);
+		if (slot->frame.empty()) break;
+		slot->detect = nframes >= next;
+		if (slot->detect) next = nframes + counter.interval.load(std::memory_order_relaxed);
+		nframes++;
+		if (slot->detect) detector.run(*slot);
+		trace.write(*slot);
+		counter.run(*slot);
+		key = renderer.run(*slot);
+	}
+	counts = counter.counts;
+	frame_slot_free(slot, pool);
+	return nframes;
+}
+
+static int run_pipeline(const Options& opt, cv::VideoCapture& capture, Counts& counts, VCPOOL* pool) {
+	int width = (int)capture.get(cv::CAP_PROP_FRAME_WIDTH);
+	int height = (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT);
+	int nworkers = opt.detectThreads < 1 ? 1 : opt.detectThreads;
+	int depth = opt.queueDepth < 1 ? 1 : opt.queueDepth;
+	// One slot in the hands of every thread, plus depth frames queued
+	int nslots = depth + 2 * nworkers + 3;
+	typedef SpscRing<FrameSlot*> Ring;
+	std::vector<Lane> lanes = counting_lanes(opt, width, height);
+	std::vector<cv::Rect> bands = detection_bands(opt, lanes, width, height);
+	TraceWriter trace;
+	if (!open_trace(opt, trace, width, height, lanes)) return 0;
+
+	std::vector<FrameSlot*> slots;
+	Ring freeSlots(nslots);
+	for (int i = 0; i < nslots; i++) {
+		slots.push_back(frame_slot_new(width, height, pool));
+		freeSlots.push(slots.back());
+	}
+	std::vector<std::unique_ptr<Ring>> toDetect, toCount;
+	std::vector<std::unique_ptr<Detector>> detectors;
+	for (int w = 0; w < nworkers; w++) {
+		toDetect.emplace_back(new Ring(depth));
+		toCount.emplace_back(new Ring(depth));
+		detectors.emplace_back(new Detector(bands, width, height, opt, pool));
+	}
+	Ring toRender(depth);
+	Counter counter(lanes, opt);
+	Renderer renderer(width, height, opt, pool);
+	std::atomic<bool> stop(false);
+
+	// A NULL slot marks the end of the video. The interval of the counter is a
+	// few frames late here, the speed of the coins changes slowly.
+	std::thread decode([&]() {
+		long next = 0;
+		for (long i = 0; !stop.load(std::memory_order_relaxed); i++) {
+			FrameSlot* slot = freeSlots.pop();
+			capture.read(slot->frame);
+			if (slot->frame.empty()) break;
+			slot->detect = i >= next;
+			if (slot->detect) next = i + counter.interval.load(std::memory_order_relaxed);
+			toDetect[i % nworkers]->push(slot);
+		}
+		for (int w = 0; w < nworkers; w++) toDetect[w]->push(NULL);
+	});
+	pin_thread(decode.native_handle(), affinity_of(opt, 0));
+
+	std::vector<std::thread> workers;
+	for (int w = 0; w < nworkers; w++) {
+		workers.emplace_back([&, w]() {
+			for (;;) {
+				FrameSlot* slot = toDetect[w]->pop();
+				if ((slot != NULL) && slot->detect) detectors[w]->run(*slot);
+				toCount[w]->push(slot);
+				if (slot == NULL) break;
+			}
+		});
+		pin_thread(workers.back().native_handle(), affinity_of(opt, 1 + w));
+	}
+
+	std::thread count([&]() {
+		for (long i = 0;; i++) {
+			FrameSlot* slot = toCount[i % nworkers]->pop();
+			if (slot != NULL) {
+				trace.write(*slot);
+				counter.run(*slot);
+			}
+			toRender.push(slot);
+			if (slot == NULL) break;
+		}
+	});
+	pin_thread(count.native_handle(), affinity_of(opt, 1 + nworkers));
+
+	// Rendering stays on the main thread (required by the HighGUI backends)
+	pin_current_thread(affinity_of(opt, 2 + nworkers));
+	int nframes = 0;
+	for (;;) {
+		FrameSlot* slot = toRender.pop();
+		if (slot == NULL) break;
+		nframes++;
+		if (renderer.run(*slot) == 'q') stop.store(true, std::memory_order_relaxed);
+		freeSlots.push(slot);
+	}
+
+	decode.join();
+	for (auto& t : workers) t.join();
+	count.join();
+
+	counts = counter.counts;
+	for (FrameSlot* slot : slots) frame_slot_free(slot, pool);
+	return nframes;
+}
+
+int run_video(const Options& opt, cv::VideoCapture& capture, Counts& counts, VCPOOL* pool) {
+	VCPOOL* own = pool == NULL ? vc_pool_new() : NULL;
+	int nframes;
+
+	if (opt.serial) nframes = run_serial(opt, capture, counts, pool != NULL ? pool : own);
+	else nframes = run_pipeline(opt, capture, counts, pool != NULL ? pool : own);
+	vc_pool_free(own);
+	return nframes;
+}
+
+#pragma endregion
+
+#pragma region Self-checks
+
+int check_simd(const Options& opt) {
+	cv::VideoCapture capture;
+	cv::Mat frame;
+	int best = vc_simd_detect();
+	int nframes = 0;
+	std::vector<int> mismatches(best + 1, 0);
+
+	capture.open(opt.inputs[0]);
+	if (!capture.isOpened()) {
+		std::cerr << "Erro ao abrir o ficheiro de video " << opt.inputs[0] << "\n";
+		return 1;
+	}
+
+	int width = (int)capture.get(cv::CAP_PROP_FRAME_WIDTH);
+	int height = (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT);
+	IVC* mask0 = vc_image_new(width, height, 1, 255);
+	IVC* mask1 = vc_image_new(width, height, 1, 255);
+	IVC* hsv0 = vc_image_new(width, height, 3, 255);
+	IVC* hsv1 = vc_image_new(width, height, 3, 255);
+	int previous = vc_simd_level();
+
+	while (capture.read(frame) && !frame.empty()) {
+		IVC view = mat_view(frame);
+		nframes++;
+
+		// Reference: the scalar code
+		vc_simd_set_level(VC_SIMD_NONE);
+		vc_bgr_to_mask(&view, mask0, coinColors, NCOINCOLORS);
+		vc_rgb_to_hsv(&view, hsv0);
+
+		for (int level = VC_SIMD_SSE41; level <= best; level++) {
+			vc_simd_set_level(level);
+			vc_bgr_to_mask(&view, mask1, coinColors, NCOINCOLORS);
+			vc_rgb_to_hsv(&view, hsv1);
+			if (memcmp(mask0->data, mask1->data, (size_t)mask0->bytesperline * height) != 0 ||
+				memcmp(hsv0->data, hsv1->data, (size_t)hsv0->bytesperline * height) != 0) mismatches[level]++;
+		}
+	}
+	vc_simd_set_level(previous);
+
+	int failed = 0;
+	std::cout << "Frames : " << nframes << "\n";
+	for (int level = VC_SIMD_SSE41; level <= best; level++) {
+		std::cout << vc_simd_name(level) << " : " << (mismatches[level] == 0 ? "OK" : "FALHOU") << " (" << mismatches[level] << " frames diferentes)\n";
+		if (mismatches[level] != 0) failed = 1;
+	}
+	if (best == VC_SIMD_NONE) std::cout << "Sem instrucoes SIMD neste processador\n";
+
+	vc_image_free(mask0);
+	vc_image_free(mask1);
+	vc_image_free(hsv0);
+	vc_image_free(hsv1);
+	return failed;
+}
+
+int bench_median(const Options& opt) {
+	cv::VideoCapture capture;
+	cv::Mat frame, ref, out;
+	double tcv = 0, tvc = 0, tmt = 0;
+	int nframes = 0, mismatches = 0, width = 0, height = 0;
+
+	capture.open(opt.inputs[0]);
+	if (!capture.isOpened()) {
+		std::cerr << "Erro ao abrir o ficheiro de video " << opt.inputs[0] << "\n";
+		return 1;
+	}
+
+	while (capture.read(frame) && !frame.empty()) {
+		nframes++;
+		width = frame.cols;
+		height = frame.rows;
+		out.create(frame.rows, frame.cols, frame.type());
+		IVC in = mat_view(frame);
+		IVC dst = mat_view(out);
+
+		auto t0 = std::chrono::steady_clock::now();
+		cv::medianBlur(frame, ref, 5);
+		auto t1 = std::chrono::steady_clock::now();
+		vc_median5(&in, &dst);
+		auto t2 = std::chrono::steady_clock::now();
+		for (int y = 0; y < ref.rows; y++) {
+			if (memcmp(ref.ptr(y), out.ptr(y), (size_t)ref.cols * ref.channels()) != 0) {
+				mismatches++;
+				break;
+			}
+		}
+		auto t3 = std::chrono::steady_clock::now();
+		vc_median5_mt(&in, &dst);
+		auto t4 = std::chrono::steady_clock::now();
+
+		tcv += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		tvc += std::chrono::duration<double, std::milli>(t2 - t1).count();
+		tmt += std::chrono::duration<double, std::milli>(t4 - t3).count();
+	}
+	if (nframes == 0) return 1;
+
+	std::cout << "Frames : " << nframes << " (" << width << "x" << height << ")\n"
+		<< "cv::medianBlur : " << tcv / nframes << " ms/frame\n"
+		<< "vc_median5 (" << vc_simd_name(vc_simd_level()) << ") : " << tvc / nframes << " ms/frame\n"
+		<< "vc_median5_mt (" << vc_parallel_threads() << " threads) : " << tmt / nframes << " ms/frame\n"
+		<< "Frames diferentes : " << mismatches << "\n";
+	return mismatches != 0;
+}
+
+#pragma endregion
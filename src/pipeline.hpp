@@ -0,0 +1,272 @@
+/*****************************************************************//**
+ * \file   pipeline.hpp
+ * \brief  Frame processing stages (detect, count, render) and the
+ *         threaded decode/detect/count/render pipeline.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+extern "C" {
+#include "vc.h"
+}
+
+// Counting line: coins are counted when their centre crosses row y between columns x0 and x1
+struct Lane {
+	int y;
+	int x0 = 0;
+	int x1 = -1;	// -1 = last column
+};
+
+// Representation of the coin masks in the detector
+enum MaskMode {
+	MASK_IMAGE,		// 1 byte per pixel
+	MASK_RLE,		// Runs of pixels (segmentation, closing and labelling)
+	MASK_BITS		// 1 bit per pixel (segmentation and closing, labelled from the bits)
+};
+
+// Command line options
+struct Options {
+	std::vector<std::string> inputs;	// Video files or directories
+	std::string report;
+	std::string outDir = "results";	// Batch mode: per-video results and summary
+	int jobs = 0;				// Batch mode: videos processed at the same time (0 = one per core)
+	bool headless = false;
+	bool serial = false;		// Run every stage on the main thread
+	int queueDepth = 4;			// Frames buffered between two stages
+	int detectThreads = 1;		// Number of detection workers
+	int kernelThreads = 1;		// Threads of the image kernels within a frame (0 = one per core)
+	std::vector<int> affinity;	// CPUs for decode, detect..., count, render
+	int lutBits = 0;			// Colour lookup table index bits (24, 21, 18), 0 = arithmetic HSV
+	bool fixedHsv = false;		// Arithmetic HSV in integers instead of floats
+	bool cvMedian = false;		// Median with cv::medianBlur instead of vc_median5
+	bool benchMedian = false;	// Time cv::medianBlur against vc_median5 on the video and exit
+	bool fullEdges = false;		// Edge overlay over the whole mask instead of around the accepted blobs
+	bool contours = false;		// Trace the contour of every coin: measured perimeter and outline (not with MASK_RLE)
+	std::vector<Lane> lanes;	// Counting lines (default: one across the middle of the frame)
+	bool roi = false;			// Only process a band around each counting line
+	int maxCoin = 200;			// Diameter of the largest coin, in pixels
+	int maxSkip = 1;			// Most frames between two detections, adapted to the speed of the coins (1 = every frame)
+	MaskMode masks = MASK_IMAGE;
+	int closeKernel = 3;		// Size of the closing that fills the coin masks
+	int stripRows = -1;			// Median, colour mask and closing a strip of rows at a time (MASK_IMAGE only):
+								// -1 = whole frame, 0 = strips sized for the L2 cache
+	int incremental = -1;		// Only process the tiles that changed: mean absolute difference per byte
+								// above which a tile changed (0 = any change), -1 = every pixel of every frame
+	int simd = -1;				// Instruction set of the colour kernels (VC_SIMD_*), -1 = best available
+	bool checkSimd = false;		// Compare the SIMD colour kernels with the scalar code and exit
+	std::string record;			// Write the blobs of every frame to this trace file
+	std::string replay;			// Count the coins of this trace file instead of a video and exit
+	std::string configs;		// Replay: classification configurations, one per line
+};
+
+// Coin counters for the whole video
+struct Counts {
+	int m200 = 0, m100 = 0, m50 = 0, m20 = 0, m10 = 0, m5 = 0, m2 = 0, m1 = 0;
+	int cont2 = 0;
+	float soma = 0;
+};
+
+// One frame travelling through the pipeline. Slots are recycled.
+struct FrameSlot {
+	cv::Mat frame;		// Decoded frame (also the displayed frame)
+	cv::Mat blurred;	// Median filtered frame (empty when only bands are processed)
+	IVC* mask;			// Binary mask of the coins (1 channel), for the overlay
+	bool detect;		// Run the detector (false: skipped frame, counted from the tracks)
+	VCARENA* arena;		// Per-frame allocations, reset when the slot is reused
+	OVC* blobs;			// Accepted blobs (in arena)
+	CVC* contours;		// Contours of the blobs (in arena), NULL when they are not traced
+	int nlabels;
+	Counts counts;		// Counters after this frame
+};
+
+// Region of the frame processed by the detector, with its own buffers
+struct Band {
+	cv::Rect rect;
+	bool full;			// Band covers the whole frame
+	cv::Mat blurred;	// Median filtered band (partial bands only)
+	IVC* imageA;		// Colour mask (MASK_IMAGE only)
+	IVC* mask;			// Closed mask (partial bands, or when there is no overlay; with runs or bits only for the overlay)
+	LVC* labels;		// 32-bit labels
+	RVC* runsA;			// Run-length encoded masks (MASK_RLE only)
+	RVC* runsB;
+	BVC* bitsA;			// Packed masks (MASK_BITS only)
+	BVC* bitsB;
+	cv::Mat stripBlur;	// Strip mode: median of the new rows of the strip (without overlay)
+	IVC* window;		// Strip mode: colour mask of the strip and its halo rows
+	IVC* closed;		// Strip mode: closing of window
+	cv::Mat reference;	// Incremental mode: pixels the cached masks were computed from
+	cv::Mat tileBlur;	// Incremental mode: median of the whole band, when most tiles changed
+	cv::Mat tileMedian;	// Incremental mode: median of one dirty tile and its halo
+	IVC* cached;		// Incremental mode: closed mask of the band, kept from frame to frame
+	IVC* tileClosed;	// Incremental mode: closing of the tiles
+	std::vector<unsigned char> dirty;	// Incremental mode: tiles that changed in this frame
+	std::vector<OVC> accepted;	// Incremental mode: accepted blobs of cached
+};
+
+// Per-thread buffers of the detection stage
+struct Detector {
+	std::vector<Band> bands;
+	std::vector<OVC> found;	// Blobs of all bands, in frame coordinates
+	std::vector<CVC> outlines;	// Contours of found (contour mode only)
+	const HSVLUT* lut;		// Colour lookup table, NULL to compute HSV per pixel
+	bool fixedHsv;			// Integer HSV when there is no table
+	bool cvMedian;
+	bool overlay;			// Fill slot.blurred for the overlay
+	bool keepMask;			// Fill slot.mask for the overlay (not needed with contours)
+	bool contours;			// Trace the contours of the accepted blobs
+	MaskMode masks;
+	int closeKernel;
+	int stripRows;			// Rows per strip, 0 = whole frame
+	int incremental;		// Tile change threshold, -1 = not incremental
+	VCPOOL* pool;
+
+	Detector(const std::vector<cv::Rect>& rects, int width, int height, const Options& opt, VCPOOL* pool);
+	~Detector();
+	void run(FrameSlot& slot);
+	void median(const cv::Mat& src, cv::Mat& dst);
+	void segment(IVC* image, IVC* mask);
+	void segment_bits(IVC* image, BVC* mask);
+	void close_strips(Band& band, const cv::Mat& frame, cv::Mat* blurred, IVC* mask);
+	bool update_tiles(Band& band, const cv::Mat& frame, cv::Mat* blurred);
+};
+
+// Coin followed from frame to frame
+struct Track {
+	int id;				// Persistent, never reused within a video
+	float x, y;			// Centre at the last frame the coin was seen
+	float py;			// Row of the centre the frame before that (new tracks: y)
+	float vx, vy;		// Displacement per frame
+	int since;			// Frames since the coin was last seen
+	int missed;			// Detections without the coin
+	int hits;			// Detections with the coin
+	int area, perimeter;	// Last blob of the coin
+	bool counted;
+};
+
+// Nearest-neighbour tracker with constant-velocity prediction. The predicted
+// centres of the tracks are hashed on a uniform grid, so every blob only looks
+// at the tracks of the 3x3 cells around it.
+struct Tracker {
+	std::vector<Track> tracks;
+	int cell;					// Grid cell size and largest distance to a prediction (largest coin)
+	int nextId = 1;
+	std::vector<int> heads;		// First track of every hash bucket, -1 = empty
+	std::vector<int> chain;		// Next track in the same bucket
+	struct Pair { float d2; int blob, track; };
+	std::vector<Pair> pairs;	// Blob and track within the gate
+	std::vector<char> assigned;	// Track already has a blob this frame
+
+	explicit Tracker(int cell) : cell(cell > 0 ? cell : 1) {}
+	/// <summary>
+	/// Associates the blobs of a frame with the tracks, updates them and starts
+	/// a track for every blob left over. match[i] is the index in tracks of
+	/// blob i, valid until the next update.
+	/// </summary>
+	void update(const OVC* blobs, int nblobs, std::vector<int>& match);
+	/// <summary>
+	/// Advances the predictions one frame without a detection.
+	/// </summary>
+	void skip();
+};
+
+// Counting. Must see the frames in order.
+struct Counter {
+	Counts counts;
+	Tracker tracker;
+	std::vector<int> match;
+	std::vector<Lane> lanes;
+	const COINRULE* rules = vc_coin_rules;	// Classification of the coins (idCoin)
+	int nrules = VC_NCOINRULES;
+	int window = 20;				// Coins are counted within window rows of a line
+	int maxSkip;
+	float speed = -1;				// Fastest coin at the last detection, in pixels per frame (-1 = not measured)
+	std::atomic<int> interval{ 1 };	// Frames from one detection to the next (read by the decoder)
+
+	Counter(const std::vector<Lane>& lanes, const Options& opt) : tracker(opt.maxCoin), lanes(lanes), maxSkip(std::max(1, opt.maxSkip)) {}
+	bool on_line(float x, float y, float py) const;
+	void run(FrameSlot& slot);
+	void plan();
+};
+
+// Overlay and display
+struct Renderer {
+	IVC* imageH;		// Edge image (fullEdges only)
+	bool headless;
+	bool fullEdges;
+	VCPOOL* pool;
+
+	Renderer(int width, int height, const Options& opt, VCPOOL* pool);
+	~Renderer();
+	int run(FrameSlot& slot);
+};
+
+// Writes the blobs given to the counter in every frame to a trace file
+struct TraceWriter {
+	std::ofstream file;
+	std::vector<unsigned char> buffer;	// One frame, written at once
+
+	bool open(const std::string& path, int width, int height, int maxCoin, const std::vector<Lane>& lanes);
+	void write(const FrameSlot& slot);
+};
+
+// Trace file loaded in memory
+struct Trace {
+	int width, height, maxCoin;
+	std::vector<Lane> lanes;
+	std::vector<int> first;		// Index of the first blob of every frame, plus the total
+	std::vector<char> skipped;	// Frame skipped by the detector
+	std::vector<OVC> blobs;
+
+	bool load(const std::string& path);
+};
+
+FrameSlot* frame_slot_new(int width, int height, VCPOOL* pool);
+void frame_slot_free(FrameSlot* slot, VCPOOL* pool);
+
+/// <summary>
+/// Processes every frame of capture and accumulates the coin counts.
+/// Image buffers come from pool (owned by the calling thread), so consecutive
+/// videos of the same size reuse them; NULL uses a pool local to the call.
+/// </summary>
+/// <returns>Number of frames processed</returns>
+int run_video(const Options& opt, cv::VideoCapture& capture, Counts& counts, VCPOOL* pool = NULL);
+
+/// <summary>
+/// Processes every video in opt.inputs (directories are expanded) on a pool of
+/// opt.jobs workers. Writes one JSON result per video and a summary to opt.outDir.
+/// </summary>
+/// <returns>0 if every video was processed, 1 otherwise</returns>
+int run_batch(const Options& opt);
+
+/// <summary>
+/// Decodes the frames of opt.inputs[0] and checks that the colour conversion and
+/// segmentation give the same bytes with every supported instruction set as
+/// with the scalar code.
+/// </summary>
+/// <returns>0 if every instruction set matches, 1 otherwise</returns>
+int check_simd(const Options& opt);
+
+/// <summary>
+/// Times cv::medianBlur, vc_median5 and vc_median5_mt on the frames of
+/// opt.inputs[0] and checks that they give the same pixels.
+/// </summary>
+/// <returns>0 if the results match, 1 otherwise</returns>
+int bench_median(const Options& opt);
+
+/// <summary>
+/// Counts the coins of the trace opt.replay once for every classification
+/// configuration of opt.configs (the rules of idCoin if empty), on opt.jobs
+/// threads, without decoding or detecting. Writes one CSV row per configuration.
+/// </summary>
+/// <returns>0 if successful, 1 on error</returns>
+int run_replay(const Options& opt);
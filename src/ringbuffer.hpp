@@ -0,0 +1,65 @@
+/*****************************************************************//**
+ * \file   ringbuffer.hpp
+ * \brief  Bounded lock-free single-producer / single-consumer queue
+ *         used to connect the pipeline stages.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstddef>
+
+/// <summary>
+/// Fixed capacity ring buffer. Exactly one thread may push and exactly one
+/// thread may pop. push/pop spin (yielding) while the ring is full/empty.
+/// </summary>
+template <typename T>
+class SpscRing {
+public:
+	explicit SpscRing(size_t capacity) : buffer(capacity + 1) {}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	bool try_push(const T& value) {
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t n = next(h);
+		if (n == tail.load(std::memory_order_acquire)) return false; // Full
+		buffer[h] = value;
+		head.store(n, std::memory_order_release);
+		return true;
+	}
+
+	bool try_pop(T& value) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false; // Empty
+		value = buffer[t];
+		tail.store(next(t), std::memory_order_release);
+		return true;
+	}
+
+	void push(const T& value) {
+		while (!try_push(value)) std::this_thread::yield();
+	}
+
+	T pop() {
+		T value;
+		while (!try_pop(value)) std::this_thread::yield();
+		return value;
+	}
+
+	size_t capacity() const { return buffer.size() - 1; }
+
+private:
+	size_t next(size_t i) const { return (i + 1 == buffer.size()) ? 0 : i + 1; }
+
+	std::vector<T> buffer;
+	// Keep producer and consumer indices on separate cache lines
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
@@ -0,0 +1,267 @@
+/*****************************************************************//**
+ * \file   rle.c
+ * \brief  Run-length encoded binary images and morphology on runs, so the
+ *         cost of the mask operations grows with the number of coin edges
+ *         instead of the number of pixels.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+// Window rows handled without a heap allocation by dilate/erode
+#define VC_RLE_MAX_STACK_KERNEL 16
+
+/// <summary>
+/// Creates an empty run-length encoded image. The run buffer grows as needed
+/// and is kept between frames.
+/// </summary>
+/// <returns>Pointer to the image, or NULL on error</returns>
+RVC* vc_rle_new(int width, int height) {
+	RVC* rle;
+
+	if ((width <= 0) || (height <= 0)) return NULL;
+
+	rle = (RVC*)malloc(sizeof(RVC));
+	if (rle == NULL) return NULL;
+
+	rle->width = width;
+	rle->height = height;
+	rle->nruns = 0;
+	rle->capacity = 2 * height;
+	rle->runs = (VCRUN*)malloc(rle->capacity * sizeof(VCRUN));
+	rle->row = (int*)calloc((size_t)height + 1, sizeof(int));
+	if ((rle->runs == NULL) || (rle->row == NULL)) return vc_rle_free(rle);
+	return rle;
+}
+
+RVC* vc_rle_free(RVC* rle) {
+	if (rle != NULL) {
+		free(rle->runs);
+		free(rle->row);
+		free(rle);
+	}
+	return NULL;
+}
+
+/// <summary>
+/// Appends the run x0 <= x < x1 to the row being written. Runs of a row must be
+/// added from left to right and must not touch (x0 > previous x1).
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_add_run(RVC* rle, int x0, int x1) {
+	VCRUN* runs;
+
+	if (rle->nruns == rle->capacity) {
+		int capacity = rle->capacity * 2;
+		runs = (VCRUN*)realloc(rle->runs, capacity * sizeof(VCRUN));
+		if (runs == NULL) return 0;
+		rle->runs = runs;
+		rle->capacity = capacity;
+	}
+	rle->runs[rle->nruns].x0 = x0;
+	rle->runs[rle->nruns].x1 = x1;
+	rle->runs[rle->nruns].label = 0;
+	rle->nruns++;
+	return 1;
+}
+
+/// <summary>
+/// Encodes a binary image (1 channel, 0 = background).
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_from_image(IVC* src, RVC* dst) {
+	int width = src->width;
+	int x, y, x0;
+
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != 1)) return 0;
+
+	dst->nruns = 0;
+	for (y = 0; y < src->height; y++) {
+		unsigned char* ps = src->data + y * src->bytesperline;
+
+		dst->row[y] = dst->nruns;
+		for (x = 0; x < width; x++) {
+			if (ps[x] == 0) continue;
+			for (x0 = x; (x < width) && (ps[x] != 0); x++);
+			if (!vc_rle_add_run(dst, x0, x)) return 0;
+		}
+	}
+	dst->row[src->height] = dst->nruns;
+	return 1;
+}
+
+/// <summary>
+/// Decodes to a binary image: 255 inside the runs, 0 elsewhere.
+/// </summary>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_to_image(RVC* src, IVC* dst) {
+	int y, i;
+
+	if ((src->width != dst->width) || (src->height != dst->height) || (dst->channels != 1)) return 0;
+
+	for (y = 0; y < src->height; y++) {
+		unsigned char* pd = dst->data + y * dst->bytesperline;
+
+		memset(pd, 0, dst->width);
+		for (i = src->row[y]; i < src->row[y + 1]; i++) {
+			memset(pd + src->runs[i].x0, 255, src->runs[i].x1 - src->runs[i].x0);
+		}
+	}
+	return 1;
+}
+
+/// <summary>
+/// Same result as vc_binary_dilate: every run is widened by kernel / 2 and the
+/// runs of the kernel / 2 rows above and below are merged into each row.
+/// </summary>
+/// <param name="src">Source image</param>
+/// <param name="dst">Destination image (not src)</param>
+/// <param name="kernel">Size of the square structuring element (odd)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_dilate(RVC* src, RVC* dst, int kernel) {
+	int stack[VC_RLE_MAX_STACK_KERNEL];
+	int* pos;
+	int width = src->width;
+	int height = src->height;
+	int bound, x, y, y0, y1, k, best;
+	int have, cx0 = 0, cx1 = 0;
+	int ok = 1;
+
+	if ((src == dst) || (kernel < 1) || (kernel % 2 == 0)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+
+	pos = kernel <= VC_RLE_MAX_STACK_KERNEL ? stack : (int*)malloc(kernel * sizeof(int));
+	if (pos == NULL) return 0;
+
+	bound = (kernel - 1) / 2;
+	dst->nruns = 0;
+	for (y = 0; (y < height) && ok; y++) {
+		y0 = y - bound < 0 ? 0 : y - bound;
+		y1 = y + bound >= height ? height - 1 : y + bound;
+		for (k = y0; k <= y1; k++) pos[k - y0] = src->row[k];
+
+		dst->row[y] = dst->nruns;
+		have = 0;
+		while (ok) {
+			// Next run of the window, in order of x0
+			best = -1;
+			for (k = y0; k <= y1; k++) {
+				if (pos[k - y0] >= src->row[k + 1]) continue;
+				if ((best < 0) || (src->runs[pos[k - y0]].x0 < src->runs[pos[best - y0]].x0)) best = k;
+			}
+			if (best < 0) break;
+
+			VCRUN* run = &src->runs[pos[best - y0]++];
+			x = run->x0 - bound < 0 ? 0 : run->x0 - bound;
+			if (have && (x <= cx1)) {
+				if (run->x1 + bound > cx1) cx1 = run->x1 + bound;
+			}
+			else {
+				if (have) ok = vc_rle_add_run(dst, cx0, cx1);
+				cx0 = x;
+				cx1 = run->x1 + bound;
+				have = 1;
+			}
+			if (cx1 > width) cx1 = width;
+		}
+		if (have && ok) ok = vc_rle_add_run(dst, cx0, cx1);
+	}
+	dst->row[height] = dst->nruns;
+
+	if (pos != stack) free(pos);
+	return ok;
+}
+
+/// <summary>
+/// Same result as vc_binary_erode (pixels outside the image are ignored): the
+/// runs of the kernel rows are intersected and every piece is narrowed by
+/// kernel / 2 on the sides that do not touch the image border.
+/// </summary>
+/// <param name="src">Source image</param>
+/// <param name="dst">Destination image (not src)</param>
+/// <param name="kernel">Size of the square structuring element (odd)</param>
+/// <returns>1 if successful, 0 on error</returns>
+int vc_rle_erode(RVC* src, RVC* dst, int kernel) {
+	int stack[VC_RLE_MAX_STACK_KERNEL];
+	int* pos;
+	int width = src->width;
+	int height = src->height;
+	int bound, y, y0, y1, k, kmin;
+	int lo, hi, x0, x1;
+	int ok = 1;
+
+	if ((src == dst) || (kernel < 1) || (kernel % 2 == 0)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+
+	pos = kernel <= VC_RLE_MAX_STACK_KERNEL ? stack : (int*)malloc(kernel * sizeof(int));
+	if (pos == NULL) return 0;
+
+	bound = (kernel - 1) / 2;
+	dst->nruns = 0;
+	for (y = 0; (y < height) && ok; y++) {
+		y0 = y - bound < 0 ? 0 : y - bound;
+		y1 = y + bound >= height ? height - 1 : y + bound;
+		for (k = y0; k <= y1; k++) pos[k - y0] = src->row[k];
+
+		dst->row[y] = dst->nruns;
+		while (ok) {
+			// Intersection of the current run of every row
+			lo = 0;
+			hi = width;
+			kmin = -1;
+			for (k = y0; k <= y1; k++) {
+				if (pos[k - y0] >= src->row[k + 1]) break;
+				VCRUN* run = &src->runs[pos[k - y0]];
+				if (run->x0 > lo) lo = run->x0;
+				if (run->x1 < hi) hi = run->x1;
+				if ((kmin < 0) || (run->x1 < src->runs[pos[kmin - y0]].x1)) kmin = k;
+			}
+			// One of the rows has no more runs
+			if (k <= y1) break;
+
+			if (lo < hi) {
+				x0 = lo == 0 ? 0 : lo + bound;
+				x1 = hi == width ? width : hi - bound;
+				if (x0 < x1) ok = vc_rle_add_run(dst, x0, x1);
+			}
+			pos[kmin - y0]++;
+		}
+	}
+	dst->row[height] = dst->nruns;
+
+	if (pos != stack) free(pos);
+	return ok;
+}
+
+/// <summary>
+/// Relabels the runs with a remap table (see vc_check_if_circle_remap) and drops
+/// the runs that end up without a blob.
+/// </summary>
+/// <param name="src">Labelled image, changed in place</param>
+/// <param name="remap">New label for every old label (0 = remove)</param>
+/// <returns>1 if successful</returns>
+int vc_rle_remap(RVC* src, const int* remap) {
+	int y, i, begin = 0, end, n = 0;
+
+	for (y = 0; y < src->height; y++) {
+		end = src->row[y + 1];
+		src->row[y] = n;
+		for (i = begin; i < end; i++) {
+			int label = remap[src->runs[i].label];
+			if (label == 0) continue;
+			src->runs[n] = src->runs[i];
+			src->runs[n++].label = label;
+		}
+		begin = end;
+	}
+	src->row[src->height] = n;
+	src->nruns = n;
+	return 1;
+}
@@ -0,0 +1,83 @@
+/*****************************************************************//**
+ * \file   tiles.c
+ * \brief  Change detection between consecutive frames, tile by tile,
+ *         for the incremental mode of the detector.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "vc.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Sum of absolute differences of n bytes
+static long tiles_sad(const unsigned char* a, const unsigned char* b, int n) {
+	long sad = 0;
+	int i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+	sad = (long)_mm_cvtsi128_si32(acc) + (long)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+	for (; i < n; i++) sad += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+	return sad;
+}
+
+/// <summary>
+/// Compares an image with a reference, tile by tile. A tile is dirty when the
+/// mean absolute difference of its bytes is more than threshold (0: any
+/// difference). Dirty tiles are copied to the reference; clean tiles keep their
+/// old pixels there, so slow changes add up until the tile is dirty.
+/// </summary>
+/// <param name="src">Image</param>
+/// <param name="ref">Reference image of the same size and channels</param>
+/// <param name="tile">Width and height of the tiles (the last row and column may be smaller)</param>
+/// <param name="threshold">Mean absolute difference per byte</param>
+/// <param name="dirty">Receives 1 or 0 for every tile, row by row</param>
+/// <returns>Number of dirty tiles, -1 on error</returns>
+int vc_dirty_tiles(IVC* src, IVC* ref, int tile, int threshold, unsigned char* dirty) {
+	int ntx, nty, tx, ty, y, x0, y0, w, h, ndirty = 0;
+	long sad, limit;
+
+	if ((src->data == NULL) || (ref->data == NULL) || (dirty == NULL) || (tile <= 0) || (threshold < 0)) return -1;
+	if ((src->width != ref->width) || (src->height != ref->height) || (src->channels != ref->channels)) return -1;
+
+	ntx = (src->width + tile - 1) / tile;
+	nty = (src->height + tile - 1) / tile;
+	for (ty = 0; ty < nty; ty++) {
+		y0 = ty * tile;
+		h = src->height - y0 < tile ? src->height - y0 : tile;
+		for (tx = 0; tx < ntx; tx++) {
+			x0 = tx * tile;
+			w = (src->width - x0 < tile ? src->width - x0 : tile) * src->channels;
+			limit = (long)threshold * w * h;
+
+			// Stops at the first row that takes the sum over the limit
+			sad = 0;
+			for (y = y0; (y < y0 + h) && (sad <= limit); y++) {
+				sad += tiles_sad(src->data + (long)y * src->bytesperline + x0 * src->channels, ref->data + (long)y * ref->bytesperline + x0 * ref->channels, w);
+			}
+			dirty[ty * ntx + tx] = sad > limit;
+			if (sad <= limit) continue;
+
+			ndirty++;
+			for (y = y0; y < y0 + h; y++) {
+				memcpy(ref->data + (long)y * ref->bytesperline + x0 * ref->channels, src->data + (long)y * src->bytesperline + x0 * src->channels, w);
+			}
+		}
+	}
+	return ndirty;
+}
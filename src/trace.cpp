@@ -0,0 +1,280 @@
+/*****************************************************************//**
+ * \file   trace.cpp
+ * \brief  Blob traces: the blobs given to the counter in every frame of
+ *         a run, recorded to a compact binary file, and the replay of
+ *         the counting stage from a trace with many classification
+ *         configurations at the same time.
+ *
+ * Trace file (little-endian):
+ *   "CQTR", u32 version, i32 width, i32 height, i32 maxCoin,
+ *   i32 nlanes, nlanes * (i32 y, i32 x0, i32 x1),
+ *   then for every frame i32 nblobs (-1 = frame skipped by the detector)
+ *   and nblobs * (u16 x, y, width, height, xc, yc, perimeter, u32 area).
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "pipeline.hpp"
+
+namespace {
+
+const char TRACE_MAGIC[4] = { 'C', 'Q', 'T', 'R' };
+const unsigned int TRACE_VERSION = 1;
+const size_t TRACE_BLOB_BYTES = 7 * 2 + 4;
+
+void put_u16(std::vector<unsigned char>& out, int v) {
+	unsigned int u = (unsigned int)std::min(std::max(v, 0), 0xffff);
+	out.push_back(u & 0xff);
+	out.push_back(u >> 8);
+}
+
+void put_u32(std::vector<unsigned char>& out, unsigned int u) {
+	for (int i = 0; i < 4; i++) out.push_back((u >> (8 * i)) & 0xff);
+}
+
+unsigned int get_u16(const unsigned char* p) {
+	return p[0] | (p[1] << 8);
+}
+
+unsigned int get_u32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// Classification configuration of the replay, one line of the configurations file
+struct ReplayConfig {
+	int line = 0;
+	int window = 20;
+	std::vector<COINRULE> rules;
+};
+
+// Bound of a rule: empty = no bound
+bool parse_bound(const std::string& text, int unbounded, int& value) {
+	if (text.empty()) {
+		value = unbounded;
+		return true;
+	}
+	char* end;
+	long v = strtol(text.c_str(), &end, 10);
+	if (*end != '\0') return false;
+	value = (int)v;
+	return true;
+}
+
+/// <summary>
+/// Parses "window=<rows>" and "coin=<value>:<amin>:<amax>:<pmin>:<pmax>"
+/// tokens (bounds may be empty). Without coin tokens the rules of idCoin are used.
+/// </summary>
+bool parse_config(const std::string& text, ReplayConfig& config) {
+	std::istringstream in(text);
+	std::string token;
+
+	while (in >> token) {
+		if (token.compare(0, 7, "window=") == 0) {
+			config.window = atoi(token.c_str() + 7);
+			if (config.window < 0) return false;
+		}
+		else if (token.compare(0, 5, "coin=") == 0) {
+			std::vector<std::string> fields;
+			std::stringstream parts(token.substr(5));
+			std::string field;
+			while (std::getline(parts, field, ':')) fields.push_back(field);
+			if (token.back() == ':') fields.push_back("");
+			if (fields.size() != 5) return false;
+
+			COINRULE rule;
+			if (!parse_bound(fields[0], 0, rule.coin) || (rule.coin <= 0)) return false;
+			if (!parse_bound(fields[1], INT_MIN, rule.amin) || !parse_bound(fields[2], INT_MAX, rule.amax)) return false;
+			if (!parse_bound(fields[3], INT_MIN, rule.pmin) || !parse_bound(fields[4], INT_MAX, rule.pmax)) return false;
+			config.rules.push_back(rule);
+		}
+		else return false;
+	}
+	if (config.rules.empty()) config.rules.assign(vc_coin_rules, vc_coin_rules + VC_NCOINRULES);
+	return true;
+}
+
+}
+
+bool TraceWriter::open(const std::string& path, int width, int height, int maxCoin, const std::vector<Lane>& lanes) {
+	file.open(path, std::ios::binary);
+	if (!file) return false;
+
+	std::vector<unsigned char> header(TRACE_MAGIC, TRACE_MAGIC + 4);
+	put_u32(header, TRACE_VERSION);
+	put_u32(header, (unsigned int)width);
+	put_u32(header, (unsigned int)height);
+	put_u32(header, (unsigned int)maxCoin);
+	put_u32(header, (unsigned int)lanes.size());
+	for (const Lane& lane : lanes) {
+		put_u32(header, (unsigned int)lane.y);
+		put_u32(header, (unsigned int)lane.x0);
+		put_u32(header, (unsigned int)lane.x1);
+	}
+	file.write((const char*)header.data(), header.size());
+	return (bool)file;
+}
+
+void TraceWriter::write(const FrameSlot& slot) {
+	if (!file.is_open()) return;
+
+	buffer.clear();
+	if (!slot.detect) {
+		put_u32(buffer, (unsigned int)-1);
+	}
+	else {
+		put_u32(buffer, (unsigned int)slot.nlabels);
+		for (int i = 0; i < slot.nlabels; i++) {
+			const OVC& blob = slot.blobs[i];
+			put_u16(buffer, blob.x);
+			put_u16(buffer, blob.y);
+			put_u16(buffer, blob.width);
+			put_u16(buffer, blob.height);
+			put_u16(buffer, blob.xc);
+			put_u16(buffer, blob.yc);
+			put_u16(buffer, blob.perimeter);
+			put_u32(buffer, (unsigned int)blob.area);
+		}
+	}
+	file.write((const char*)buffer.data(), buffer.size());
+}
+
+bool Trace::load(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const unsigned char* p = data.data();
+	const unsigned char* end = p + data.size();
+
+	if ((data.size() < 24) || (memcmp(p, TRACE_MAGIC, 4) != 0) || (get_u32(p + 4) != TRACE_VERSION)) return false;
+	width = (int)get_u32(p + 8);
+	height = (int)get_u32(p + 12);
+	maxCoin = (int)get_u32(p + 16);
+	int nlanes = (int)get_u32(p + 20);
+	p += 24;
+	if ((nlanes < 0) || ((size_t)(end - p) < (size_t)nlanes * 12)) return false;
+	lanes.resize(nlanes);
+	for (Lane& lane : lanes) {
+		lane.y = (int)get_u32(p);
+		lane.x0 = (int)get_u32(p + 4);
+		lane.x1 = (int)get_u32(p + 8);
+		p += 12;
+	}
+
+	first.clear();
+	skipped.clear();
+	blobs.clear();
+	while (p < end) {
+		if (end - p < 4) return false;
+		int n = (int)get_u32(p);
+		p += 4;
+		first.push_back((int)blobs.size());
+		skipped.push_back(n < 0);
+		if (n < 0) continue;
+		if ((size_t)(end - p) < n * TRACE_BLOB_BYTES) return false;
+		for (int i = 0; i < n; i++, p += TRACE_BLOB_BYTES) {
+			OVC blob;
+			memset(&blob, 0, sizeof(blob));
+			blob.x = (int)get_u16(p);
+			blob.y = (int)get_u16(p + 2);
+			blob.width = (int)get_u16(p + 4);
+			blob.height = (int)get_u16(p + 6);
+			blob.xc = (int)get_u16(p + 8);
+			blob.yc = (int)get_u16(p + 10);
+			blob.perimeter = (int)get_u16(p + 12);
+			blob.area = (int)get_u32(p + 14);
+			blob.xf = blob.x + blob.width - 1;
+			blob.yf = blob.y + blob.height - 1;
+			blob.label = i + 1;
+			blobs.push_back(blob);
+		}
+	}
+	first.push_back((int)blobs.size());
+	return true;
+}
+
+int run_replay(const Options& opt) {
+	Trace trace;
+	if (!trace.load(opt.replay)) {
+		std::cerr << "Erro ao ler o trace " << opt.replay << "\n";
+		return 1;
+	}
+
+	std::vector<ReplayConfig> configs;
+	if (opt.configs.empty()) configs.push_back(ReplayConfig());
+	else {
+		std::ifstream in(opt.configs);
+		if (!in) {
+			std::cerr << "Erro ao abrir as configuracoes " << opt.configs << "\n";
+			return 1;
+		}
+		std::string text;
+		for (int line = 1; std::getline(in, text); line++) {
+			size_t start = text.find_first_not_of(" \t\r");
+			if ((start == std::string::npos) || (text[start] == '#')) continue;
+			ReplayConfig config;
+			config.line = line;
+			if (!parse_config(text, config)) {
+				std::cerr << "Configuracao invalida na linha " << line << "\n";
+				return 1;
+			}
+			configs.push_back(config);
+		}
+	}
+	if (configs.empty()) configs.push_back(ReplayConfig());
+	for (ReplayConfig& config : configs) {
+		if (config.rules.empty()) config.rules.assign(vc_coin_rules, vc_coin_rules + VC_NCOINRULES);
+	}
+
+	// The counter of the recorded run: same lanes and tracker gate
+	Options base = opt;
+	base.maxCoin = trace.maxCoin;
+	int nframes = (int)trace.first.size() - 1;
+	std::vector<Counts> results(configs.size());
+	std::atomic<size_t> next{ 0 };
+	auto start = std::chrono::steady_clock::now();
+
+	int nthreads = opt.jobs > 0 ? opt.jobs : (int)std::thread::hardware_concurrency();
+	nthreads = std::max(1, std::min(nthreads, (int)configs.size()));
+	std::vector<std::thread> workers;
+	for (int t = 0; t < nthreads; t++) {
+		workers.emplace_back([&]() {
+			FrameSlot slot;
+			for (size_t c = next++; c < configs.size(); c = next++) {
+				Counter counter(trace.lanes, base);
+				counter.rules = configs[c].rules.data();
+				counter.nrules = (int)configs[c].rules.size();
+				counter.window = configs[c].window;
+				for (int f = 0; f < nframes; f++) {
+					slot.detect = !trace.skipped[f];
+					slot.nlabels = trace.first[f + 1] - trace.first[f];
+					slot.blobs = slot.nlabels > 0 ? &trace.blobs[trace.first[f]] : NULL;
+					counter.run(slot);
+				}
+				results[c] = counter.counts;
+			}
+		});
+	}
+	for (std::thread& worker : workers) worker.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "config,total,coins,m200,m100,m50,m20,m10,m5,m2,m1\n";
+	for (size_t c = 0; c < configs.size(); c++) {
+		const Counts& r = results[c];
+		std::cout << configs[c].line << "," << std::to_string(r.soma) << "," << r.cont2 << "," << r.m200 << "," << r.m100 << "," << r.m50
+			<< "," << r.m20 << "," << r.m10 << "," << r.m5 << "," << r.m2 << "," << r.m1 << "\n";
+	}
+	std::cerr << configs.size() << " configuracoes, " << nframes << " frames, " << seconds << " s ("
+		<< (seconds > 0 ? configs.size() / seconds : 0.0) << " configuracoes/s, " << nthreads << " threads)\n";
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*****************************************************************//**
+ * \file   tracker.cpp
+ * \brief  Coin tracker of the counting stage: persistent track IDs,
+ *         constant-velocity prediction and a spatial hash for the
+ *         association of blobs with tracks.
+ *
+ * Each frame the tracks are hashed by the cell of their predicted centre.
+ * A blob only looks at the tracks of the 3x3 cells around its own centre,
+ * and the candidate pairs are assigned nearest first, so the cost grows
+ * with the number of coins, not with its square.
+ *
+ * \author David Carvalho & Gonçalo Vidal & Diogo Marques & Gabriel Fortes
+ * \date   May 2025
+ *********************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include "pipeline.hpp"
+
+namespace {
+
+// Detections a track is kept without a blob (coins hidden for a moment, missed detections)
+const int TRACK_MAX_MISSED = 5;
+
+// Bucket of a grid cell; buckets is a power of two
+inline int cell_bucket(int cx, int cy, int buckets) {
+	unsigned int h = (unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u;
+	return (int)(h & (unsigned int)(buckets - 1));
+}
+
+inline int cell_of(float v, int cell) {
+	return (int)std::floor(v / cell);
+}
+
+}
+
+void Tracker::update(const OVC* blobs, int nblobs, std::vector<int>& match) {
+	// Tracks lost for too long are dropped (match of the previous frame is stale by now)
+	tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [](const Track& t) { return t.missed > TRACK_MAX_MISSED; }), tracks.end());
+
+	int ntracks = (int)tracks.size();
+	int buckets = 16;
+	while (buckets < 2 * ntracks) buckets *= 2;
+	heads.assign(buckets, -1);
+	chain.resize(ntracks);
+	for (int t = 0; t < ntracks; t++) {
+		const Track& track = tracks[t];
+		int steps = track.since + 1;
+		int b = cell_bucket(cell_of(track.x + track.vx * steps, cell), cell_of(track.y + track.vy * steps, cell), buckets);
+		chain[t] = heads[b];
+		heads[b] = t;
+	}
+
+	// Candidate pairs: tracks predicted within one cell of the blob
+	float gate = (float)cell * cell;
+	pairs.clear();
+	for (int i = 0; i < nblobs; i++) {
+		int cx = cell_of((float)blobs[i].xc, cell);
+		int cy = cell_of((float)blobs[i].yc, cell);
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int t = heads[cell_bucket(cx + dx, cy + dy, buckets)]; t >= 0; t = chain[t]) {
+					const Track& track = tracks[t];
+					int steps = track.since + 1;
+					float ex = blobs[i].xc - (track.x + track.vx * steps);
+					float ey = blobs[i].yc - (track.y + track.vy * steps);
+					float d2 = ex * ex + ey * ey;
+					if (d2 <= gate) pairs.push_back({ d2, i, t });
+				}
+			}
+		}
+	}
+	// Nearest pairs first; a bucket shared by two cells may list a pair twice
+	std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.d2 < b.d2; });
+
+	match.assign(nblobs, -1);
+	assigned.assign(ntracks, 0);
+	for (const Pair& pair : pairs) {
+		if ((match[pair.blob] >= 0) || assigned[pair.track]) continue;
+		match[pair.blob] = pair.track;
+		assigned[pair.track] = 1;
+
+		Track& track = tracks[pair.track];
+		float x = (float)blobs[pair.blob].xc;
+		float y = (float)blobs[pair.blob].yc;
+		int steps = track.since + 1;
+		track.vx = (x - track.x) / steps;
+		track.vy = (y - track.y) / steps;
+		track.py = track.y;
+		track.x = x;
+		track.y = y;
+		track.since = 0;
+		track.missed = 0;
+		track.hits++;
+		track.area = blobs[pair.blob].area;
+		track.perimeter = blobs[pair.blob].perimeter;
+	}
+	for (int t = 0; t < ntracks; t++) {
+		if (assigned[t]) continue;
+		tracks[t].since++;
+		tracks[t].missed++;
+	}
+
+	// Blobs left over start new tracks
+	for (int i = 0; i < nblobs; i++) {
+		if (match[i] >= 0) continue;
+		Track track;
+		track.id = nextId++;
+		track.x = (float)blobs[i].xc;
+		track.y = track.py = (float)blobs[i].yc;
+		track.vx = track.vy = 0;
+		track.since = 0;
+		track.missed = 0;
+		track.hits = 1;
+		track.area = blobs[i].area;
+		track.perimeter = blobs[i].perimeter;
+		track.counted = false;
+		match[i] = (int)tracks.size();
+		tracks.push_back(track);
+	}
+}
+
+void Tracker::skip() {
+	for (Track& track : tracks) track.since++;
+}
@@ -98,4 +98,33 @@ int vc_limit2(IVC* src, IVC* dst, int y) {
 		}
 	}
 	return 1;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Copies src into the rectangle of dst that starts at (x, y), like vc_limit2
+/// but for any position, size and number of channels. Parts outside dst are skipped.
+/// </summary>
+/// <param name="src">Source image (the region)</param>
+/// <param name="dst">Destination image (same number of channels)</param>
+/// <param name="x">Column of dst where the region starts</param>
+/// <param name="y">Row of dst where the region starts</param>
+/// <returns>1 on success, 0 on failure</returns>
+int vc_paste_roi(IVC* src, IVC* dst, int x, int y) {
+	int channels = src->channels;
+	int x0 = x < 0 ? -x : 0;
+	int y0 = y < 0 ? -y : 0;
+	int x1 = src->width;
+	int y1 = src->height;
+	int yy;
+
+	if ((src->data == NULL) || (dst->data == NULL) || (channels != dst->channels)) return 0;
+	if (x + x1 > dst->width) x1 = dst->width - x;
+	if (y + y1 > dst->height) y1 = dst->height - y;
+	if ((x1 <= x0) || (y1 <= y0)) return 1;
+
+	for (yy = y0; yy < y1; yy++) {
+		memcpy(dst->data + (y + yy) * dst->bytesperline + (x + x0) * channels,
+			src->data + yy * src->bytesperline + x0 * channels, (x1 - x0) * channels);
+	}
+	return 1;
+}
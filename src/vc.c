@@ -29,6 +29,7 @@ IVC *vc_image_new(int width, int height, int channels, int levels)
 	image->channels = channels;
 	image->levels = levels;
 	image->bytesperline = image->width * image->channels;
+	image->borrowed = 0;
 	image->data = (unsigned char *) malloc(image->width * image->height * image->channels * sizeof(char));
 
 	if(image->data == NULL)
@@ -40,15 +41,38 @@ IVC *vc_image_new(int width, int height, int channels, int levels)
 }
 
 
+// Creates an image that uses external pixels (e.g. a cv::Mat) without copying them.
+// bytesperline is the stride of data; vc_image_free only releases the header.
+IVC *vc_image_view(unsigned char *data, int width, int height, int channels, int bytesperline)
+{
+	IVC *image;
+
+	if((data == NULL) || (width <= 0) || (height <= 0) || (bytesperline < width * channels)) return NULL;
+
+	image = (IVC *) malloc(sizeof(IVC));
+	if(image == NULL) return NULL;
+
+	image->data = data;
+	image->width = width;
+	image->height = height;
+	image->channels = channels;
+	image->levels = 255;
+	image->bytesperline = bytesperline;
+	image->borrowed = 1;
+
+	return image;
+}
+
+
 IVC *vc_image_free(IVC *image)
 {
 	if(image != NULL)
 	{
-		if(image->data != NULL)
+		if((image->data != NULL) && !image->borrowed)
 		{
 			free(image->data);
-			image->data = NULL;
 		}
+		image->data = NULL;
 
 		free(image);
 		image = NULL;
@@ -16,6 +16,7 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
 
@@ -25,6 +26,7 @@ typedef struct {
 	int channels;		
 	int levels;				
 	int bytesperline;		
+	int borrowed;			// 1 if data belongs to someone else (see vc_image_view)
 } IVC;
 
 #define MAX3(a, b, c) (a > b ? (a > c ? a : c) : (b > c ? b : c))
@@ -32,19 +34,158 @@ typedef struct {
 
 IVC *vc_image_new(int width, int height, int channels, int levels);
 IVC *vc_image_free(IVC *image);
+IVC *vc_image_view(unsigned char *data, int width, int height, int channels, int bytesperline);
 IVC *vc_read_image(char *filename);
 int vc_write_image(char *filename, IVC *image);
 int vc_add_image(IVC* src, IVC* dst);
 
+#pragma region Memory
+typedef struct VCARENABLOCK {
+	struct VCARENABLOCK *next;
+	size_t size;
+	size_t used;
+} VCARENABLOCK;
+
+// Frame-scoped bump allocator: everything is released at once by vc_arena_reset
+typedef struct {
+	VCARENABLOCK *blocks;
+	size_t used;			// Bytes allocated since the last reset
+	size_t peak;			// Largest value of used
+} VCARENA;
+
+// Images kept for reuse, looked up by (width, height, channels)
+typedef struct {
+	IVC **images;
+	int count;
+	int capacity;
+} VCPOOL;
+
+VCARENA* vc_arena_new(size_t size);
+VCARENA* vc_arena_free(VCARENA* arena);
+void* vc_arena_alloc(VCARENA* arena, size_t n, size_t size);
+void* vc_arena_alloc_raw(VCARENA* arena, size_t n, size_t size);
+void vc_arena_reset(VCARENA* arena);
+void* vc_alloc(VCARENA* arena, size_t n, size_t size);
+void* vc_alloc_raw(VCARENA* arena, size_t n, size_t size);
+void vc_release(VCARENA* arena, void* p);
+VCPOOL* vc_pool_new(void);
+VCPOOL* vc_pool_free(VCPOOL* pool);
+IVC* vc_pool_get(VCPOOL* pool, int width, int height, int channels);
+IVC* vc_pool_put(VCPOOL* pool, IVC* image);
+#pragma endregion
+
+#pragma region RLE
+// Horizontal run of foreground pixels x0 <= x < x1
+typedef struct {
+	int x0, x1;
+	int label;				// Blob of the run (0 = none), see vc_rle_blob_labelling
+} VCRUN;
+
+// Run-length encoded binary image. The runs of row y are runs[row[y]] to
+// runs[row[y + 1] - 1], sorted by x0; a producer sets row[y] = nruns before
+// adding the runs of row y and row[height] = nruns at the end.
+typedef struct {
+	int width, height;
+	VCRUN *runs;
+	int nruns;
+	int capacity;
+	int *row;				// height + 1 entries
+} RVC;
+
+RVC* vc_rle_new(int width, int height);
+RVC* vc_rle_free(RVC* rle);
+int vc_rle_add_run(RVC* rle, int x0, int x1);
+int vc_rle_from_image(IVC* src, RVC* dst);
+int vc_rle_to_image(RVC* src, IVC* dst);
+int vc_rle_dilate(RVC* src, RVC* dst, int kernel);
+int vc_rle_erode(RVC* src, RVC* dst, int kernel);
+int vc_rle_remap(RVC* src, const int* remap);
+#pragma endregion
+
+#pragma region Bitmask
+// Binary image packed 1 bit per pixel: pixel x of a row is bit x % 64 of word x / 64
+typedef struct {
+	uint64_t *data;
+	int width, height;
+	int words;				// 64-bit words per row (bits past width are 0)
+} BVC;
+
+BVC* vc_bits_new(int width, int height);
+BVC* vc_bits_free(BVC* bits);
+void vc_bits_pack_row(const unsigned char* src, int n, uint64_t* dst);
+void vc_bits_unpack_row(const uint64_t* src, int n, unsigned char* dst);
+int vc_bits_from_image(IVC* src, BVC* dst);
+int vc_bits_to_image(BVC* src, IVC* dst);
+int vc_bits_dilate(BVC* src, BVC* dst, int kernel);
+int vc_bits_erode(BVC* src, BVC* dst, int kernel);
+int vc_bits_or(BVC* a, BVC* b, BVC* dst);
+int vc_bits_and(BVC* a, BVC* b, BVC* dst);
+#pragma endregion
+
+#pragma region SIMD
+// Instruction sets of the colour kernels (see vc_simd_set_level)
+#define VC_SIMD_NONE 0
+#define VC_SIMD_SSE41 1
+#define VC_SIMD_AVX2 2
+#define VC_SIMD_AVX512 3
+
+int vc_simd_detect(void);
+int vc_simd_level(void);
+int vc_simd_set_level(int level);
+const char* vc_simd_name(int level);
+int vc_simd_hsv_row(const unsigned char* src, int n, int bgr, unsigned char* dst);
+int vc_simd_mask_row(const unsigned char* src, int n, int bgr, const unsigned char* lo, const unsigned char* hi, int nranges, unsigned char* dst);
+#pragma endregion
+
 #pragma region Colors
+typedef struct {
+	int hmin, hmax;		// [0, 360]
+	int smin, smax;		// [0, 100]
+	int vmin, vmax;		// [0, 100]
+} HSVRANGE;
+
 int vc_rgb_to_hsv(IVC* src, IVC* dst);
 int vc_gbr_rgb(IVC* src);
 int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+int vc_bgr_to_mask(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges);
+
+#define VC_LUT_MAX_RANGES 8
+
+// Colour lookup table: class bitmask (bit k = range k) per quantised RGB colour
+typedef struct {
+	unsigned char* table;
+	int bits;			// Bits per channel (8, 7 or 6)
+	int nranges;
+	HSVRANGE ranges[VC_LUT_MAX_RANGES];
+} HSVLUT;
+
+HSVLUT* vc_hsv_lut_new(int bits);
+HSVLUT* vc_hsv_lut_free(HSVLUT* lut);
+int vc_hsv_lut_set(HSVLUT* lut, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_mask_lut(IVC* src, IVC* dst, const HSVLUT* lut);
+int vc_bgr_to_rle(IVC* src, RVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_rle_lut(IVC* src, RVC* dst, const HSVLUT* lut);
+int vc_bgr_to_bits(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_bits_lut(IVC* src, BVC* dst, const HSVLUT* lut);
+
+// Integer-only HSV (reciprocal tables, no floating point)
+int vc_rgb_to_hsv_fixed(IVC* src, IVC* dst);
+int vc_bgr_to_mask_fixed(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_rle_fixed(IVC* src, RVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_bits_fixed(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges);
 #pragma endregion
 
 #pragma region MorphologicalOperators
 int vc_binary_dilate(IVC* src, IVC* dst, int kernel);
 int vc_binary_erode(IVC* src, IVC* dst, int kernel);
+int vc_binary_dilate_vhgw(IVC* src, IVC* dst, int kernel);
+int vc_binary_erode_vhgw(IVC* src, IVC* dst, int kernel);
+int vc_binary_close(IVC* src, IVC* dst, int kernel);
+#pragma endregion
+
+#pragma region Filters
+int vc_median5(IVC* src, IVC* dst);
+int vc_median5_rows(IVC* src, int y0, int y1, IVC* dst);
 #pragma endregion
 
 #pragma region Edges
@@ -57,6 +198,35 @@ int vc_three_to_one_channel(IVC* src, IVC* dst);
 int vc_one_to_three_channel(IVC* src, IVC* dst);
 int vc_limit(IVC* src, IVC* dst, int y);
 int vc_limit2(IVC* src, IVC* dst, int y);
+int vc_paste_roi(IVC* src, IVC* dst, int x, int y);
+int vc_dirty_tiles(IVC* src, IVC* ref, int tile, int threshold, unsigned char* dirty);
+#pragma endregion
+
+#pragma region Parallel
+// Threads used by the *_mt kernels (parallel.cpp): 1 = serial (default), 0 = one per core
+int vc_parallel_set_threads(int nthreads);
+int vc_parallel_threads(void);
+
+// Same arguments and result as the serial kernels, split into bands of rows
+int vc_rgb_to_hsv_mt(IVC* src, IVC* dst);
+int vc_rgb_to_hsv_fixed_mt(IVC* src, IVC* dst);
+int vc_gbr_rgb_mt(IVC* src);
+int vc_hsv_segmentation_mt(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax);
+int vc_bgr_to_mask_mt(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_mask_lut_mt(IVC* src, IVC* dst, const HSVLUT* lut);
+int vc_bgr_to_mask_fixed_mt(IVC* src, IVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_bits_mt(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_bgr_to_bits_lut_mt(IVC* src, BVC* dst, const HSVLUT* lut);
+int vc_bgr_to_bits_fixed_mt(IVC* src, BVC* dst, const HSVRANGE* ranges, int nranges);
+int vc_add_image_mt(IVC* src, IVC* dst);
+int vc_three_to_one_channel_mt(IVC* src, IVC* dst);
+int vc_one_to_three_channel_mt(IVC* src, IVC* dst);
+int vc_draw_edge_mt(IVC* src, IVC* dst);
+int vc_binary_dilate_mt(IVC* src, IVC* dst, int kernel);
+int vc_binary_erode_mt(IVC* src, IVC* dst, int kernel);
+int vc_binary_close_mt(IVC* src, IVC* dst, int kernel);
+int vc_gray_edge_prewitt_mt(IVC* src, IVC* dst);
+int vc_median5_mt(IVC* src, IVC* dst);
 #pragma endregion
 
 #pragma region Labelling
@@ -65,20 +235,67 @@ typedef struct {
 	int area;					
 	int xc, yc;					
 	int perimeter;				
+	int boundary;		// Boundary pixels (4-connectivity), vc_label_blob_info and vc_rle_blob_info only
 	int label;					
 } OVC;
 
+// 32-bit label image (0 = background, blobs are labelled 1..nlabels)
+typedef struct {
+	int* data;
+	int width, height;
+} LVC;
+
 OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels);
+OVC* vc_binary_blob_labelling_arena(IVC* src, IVC* dst, int* nlabels, VCARENA* arena);
 int vc_binary_blob_info(IVC* src, OVC* blobs, int nlabels);
+LVC* vc_labels_new(int width, int height);
+LVC* vc_labels_free(LVC* labels);
+OVC* vc_binary_blob_labelling_uf(IVC* src, LVC* dst, int* nlabels, VCARENA* arena);
+OVC* vc_bits_blob_labelling_uf(BVC* src, LVC* dst, int* nlabels, VCARENA* arena);
+int vc_label_blob_info(LVC* src, OVC* blobs, int nlabels, VCARENA* arena);
 int vc_draw_bounding_box(IVC* dest, OVC* blobs, int nlabels);
+int vc_draw_blob_edges(IVC* src, IVC* dst, OVC* blobs, int nlabels, int margin);
 OVC* vc_check_if_circle(OVC* blobs, int* nLabels, IVC* src);
+OVC* vc_check_if_circle_arena(OVC* blobs, int* nLabels, IVC* src, VCARENA* arena);
+OVC* vc_check_if_circle_remap(OVC* blobs, int* nLabels, int* remap);
+int vc_labels_remap(LVC* src, const int* remap, IVC* dst);
+OVC* vc_rle_blob_labelling(RVC* src, int* nlabels, VCARENA* arena);
+int vc_rle_blob_info(RVC* src, OVC* blobs, int nlabels, VCARENA* arena);
 int vc_check_collisions(OVC firstBlob, OVC secondBlob);
 int vc_main_collisions(OVC blob, OVC* secondBlobs, int secondBlob);
 int vc_delete_blob(IVC* img, OVC blob);
+
+// Coin value (cents) of the blobs within inclusive area and perimeter bounds
+typedef struct {
+	int coin;
+	int amin, amax;
+	int pmin, pmax;
+} COINRULE;
+
+#define VC_NCOINRULES 8
+extern const COINRULE vc_coin_rules[VC_NCOINRULES];
+
+int vc_coin_classify(const COINRULE* rules, int nrules, int area, int perimeter);
 int idCoin(int area, int perimeter);
 int vc_center(OVC* blobs, IVC* dst, int nlabels);
 #pragma endregion
 
+#pragma region Contours
+// Outer contour of a blob as a Freeman chain code: codes[i] is the step from one
+// boundary pixel to the next (0 = east, then counter-clockwise in 45 degree
+// steps, y pointing down), starting and ending at (x, y)
+typedef struct {
+	int x, y;
+	int length;
+	unsigned char* codes;
+} CVC;
+
+int vc_trace_contour(LVC* src, int label, int x, int y, unsigned char* codes, int capacity);
+int vc_label_contours(LVC* src, OVC* blobs, int nlabels, CVC* contours, VCARENA* arena);
+float vc_contour_perimeter(const CVC* contour);
+int vc_draw_contours(IVC* dst, const CVC* contours, int ncontours);
+#pragma endregion
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file